@@ -0,0 +1,246 @@
+#include "Allocator.h"
+#include <algorithm>
+#include <new>
+#include <string>
+
+using namespace sglib;
+
+namespace {
+    std::mutex installed;
+    std::shared_ptr<Allocator> current;
+    const size_t smallestClass = 64;
+}
+
+BudgetExceeded::BudgetExceeded(uint64_t requested, uint64_t live, uint64_t limit) :
+        requestedBytes(requested), liveBytes(live), limitBytes(limit) {
+    const std::string amount = requested == MemoryBudget::unlimited ? "a size too large to represent" :
+                               std::to_string(requested) + " bytes";
+    const std::string most = limit == MemoryBudget::unlimited ? "no limit" : "a limit of " + std::to_string(limit);
+    message = std::make_shared<const std::string>("memory budget exceeded: " + amount + " requested with " +
+                                                  std::to_string(live) + " bytes in use and " + most);
+}
+
+const char* BudgetExceeded::what() const noexcept {
+    return message->c_str();
+}
+
+uint64_t BudgetExceeded::requested() const {
+    return requestedBytes;
+}
+
+uint64_t BudgetExceeded::live() const {
+    return liveBytes;
+}
+
+uint64_t BudgetExceeded::limit() const {
+    return limitBytes;
+}
+
+MemoryBudget::MemoryBudget(uint64_t limit) : limitBytes(limit), liveBytes(0), peakBytes(0) { }
+
+void MemoryBudget::reserve(uint64_t bytes) {
+    const uint64_t most = limitBytes.load(std::memory_order_relaxed);
+    uint64_t current = liveBytes.load(std::memory_order_relaxed);
+    do {
+        if (bytes > most || current > most - bytes) {
+            throw BudgetExceeded(bytes, current, most);
+        }
+    } while (!liveBytes.compare_exchange_weak(current, current + bytes, std::memory_order_relaxed));
+    const uint64_t now = current + bytes;
+    uint64_t seen = peakBytes.load(std::memory_order_relaxed);
+    while (now > seen && !peakBytes.compare_exchange_weak(seen, now, std::memory_order_relaxed)) { }
+}
+
+void MemoryBudget::release(uint64_t bytes) {
+    liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool MemoryBudget::admits(uint64_t bytes) const {
+    const uint64_t most = limitBytes.load(std::memory_order_relaxed);
+    return bytes <= most && liveBytes.load(std::memory_order_relaxed) <= most - bytes;
+}
+
+void MemoryBudget::require(uint64_t bytes) const {
+    if (!admits(bytes)) {
+        throw BudgetExceeded(bytes, live(), limit());
+    }
+}
+
+void MemoryBudget::setLimit(uint64_t limit) {
+    limitBytes.store(limit, std::memory_order_relaxed);
+}
+
+uint64_t MemoryBudget::limit() const {
+    return limitBytes.load(std::memory_order_relaxed);
+}
+
+uint64_t MemoryBudget::live() const {
+    return liveBytes.load(std::memory_order_relaxed);
+}
+
+uint64_t MemoryBudget::peak() const {
+    return peakBytes.load(std::memory_order_relaxed);
+}
+
+void MemoryBudget::resetPeak() {
+    peakBytes.store(live(), std::memory_order_relaxed);
+}
+
+MemoryBudget& MemoryBudget::process() {
+    // Never destroyed, since buffers held by other statics are released after it would be.
+    static auto* budget = new MemoryBudget();
+    return *budget;
+}
+
+std::shared_ptr<Allocator> Allocator::get() {
+    std::lock_guard<std::mutex> lock(installed);
+    if (current == nullptr) {
+        current = std::make_shared<PoolAllocator>();
+    }
+    return current;
+}
+
+void Allocator::set(std::shared_ptr<Allocator> allocator) {
+    std::lock_guard<std::mutex> lock(installed);
+    current = std::move(allocator);
+}
+
+void* HeapAllocator::allocate(size_t bytes) {
+    return ::operator new(bytes);
+}
+
+void HeapAllocator::deallocate(void* memory, size_t bytes) {
+    ::operator delete(memory, bytes);
+}
+
+PoolAllocator::PoolAllocator(size_t retainedBytes) : limit(retainedBytes) { }
+
+PoolAllocator::~PoolAllocator() {
+    trim();
+}
+
+size_t PoolAllocator::sizeClass(size_t bytes) {
+    if (bytes <= smallestClass) {
+        return smallestClass;
+    }
+    // Steps of a quarter of the power of two below `bytes`: 64, 80, 96, 112, 128, 160, ...
+    size_t top = 1;
+    while (top <= (bytes - 1) >> 1) {
+        top <<= 1;
+    }
+    const size_t step = top >> 2;
+    if (bytes > static_cast<size_t>(-1) - step) {
+        throw std::bad_alloc();
+    }
+    return (bytes + step - 1) / step * step;
+}
+
+void* PoolAllocator::allocate(size_t bytes) {
+    const size_t size = sizeClass(bytes);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto found = blocks.find(size);
+        if (found != blocks.end() && !found->second.empty()) {
+            void* block = found->second.back();
+            found->second.pop_back();
+            held -= size;
+            return block;
+        }
+    }
+    return ::operator new(size);
+}
+
+void PoolAllocator::deallocate(void* memory, size_t bytes) {
+    if (memory == nullptr) {
+        return;
+    }
+    const size_t size = sizeClass(bytes);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (held + size <= limit) {
+            try {
+                blocks[size].push_back(memory);
+                held += size;
+                return;
+            } catch (const std::bad_alloc&) { }
+        }
+    }
+    ::operator delete(memory);
+}
+
+size_t PoolAllocator::retained() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return held;
+}
+
+void PoolAllocator::trim() {
+    std::map<size_t, std::vector<void*>> released;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        released.swap(blocks);
+        held = 0;
+    }
+    for (const auto& sized : released) {
+        for (void* block : sized.second) {
+            ::operator delete(block);
+        }
+    }
+}
+
+Arena::Scope::Scope(Arena& arena) : arena(arena), block(arena.current), used(arena.used) { }
+
+Arena::Scope::~Scope() {
+    arena.current = block;
+    arena.used = used;
+}
+
+Arena::Arena(size_t blockSize) : blockSize(std::max<size_t>(blockSize, smallestClass)) { }
+
+Arena::~Arena() {
+    for (const auto& block : blocks) {
+        ::operator delete(block.data);
+        MemoryBudget::process().release(block.size);
+    }
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment) {
+    if (!blocks.empty()) {
+        const size_t start = (used + alignment - 1) / alignment * alignment;
+        if (start <= blocks[current].size && bytes <= blocks[current].size - start) {
+            used = start + bytes;
+            return blocks[current].data + start;
+        }
+    }
+    // Blocks come from operator new, aligned for any fundamental type, so a fresh block
+    // needs no padding at its start.
+    const size_t next = blocks.empty() ? 0 : current + 1;
+    if (next == blocks.size() || blocks[next].size < bytes) {
+        const size_t size = std::max(blockSize, bytes);
+        MemoryBudget::process().reserve(size);
+        uint8_t* data = nullptr;
+        try {
+            data = static_cast<uint8_t*>(::operator new(size));
+            blocks.insert(blocks.begin() + static_cast<std::ptrdiff_t>(next), {data, size});
+        } catch (...) {
+            ::operator delete(data);
+            MemoryBudget::process().release(size);
+            throw;
+        }
+    }
+    current = next;
+    used = bytes;
+    return blocks[current].data;
+}
+
+size_t Arena::capacity() const {
+    size_t result = 0;
+    for (const auto& block : blocks) {
+        result += block.size;
+    }
+    return result;
+}
+
+Arena& Arena::local() {
+    thread_local Arena arena;
+    return arena;
+}
@@ -0,0 +1,249 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace sglib {
+    // Thrown by an allocation that would take a MemoryBudget past its limit, before any memory
+    // is taken. It is a std::bad_alloc, so code prepared to run out of memory handles it too.
+    class BudgetExceeded : public std::bad_alloc {
+    public:
+        BudgetExceeded(uint64_t requested, uint64_t live, uint64_t limit);
+        const char* what() const noexcept override;
+        uint64_t requested() const;
+        // Bytes in use, and the limit, of the budget that refused.
+        uint64_t live() const;
+        uint64_t limit() const;
+
+    private:
+        uint64_t requestedBytes, liveBytes, limitBytes;
+        std::shared_ptr<const std::string> message;
+    };
+
+    // Counts the bytes of pixel buffers and large temporaries in use and refuses allocations that
+    // would take them past a limit. process() counts everything the library allocates; a Canvas
+    // can be given a budget of its own, which counts its pixels, those of its copies and layers,
+    // and is checked on top of the process budget:
+    //
+    //     auto budget = std::make_shared<MemoryBudget>(256 << 20);
+    //     Canvas canvas(width, height, Color::white, Pixels::Storage::Tiled, budget);
+    class MemoryBudget {
+    public:
+        const static uint64_t unlimited = static_cast<uint64_t>(-1);
+
+        explicit MemoryBudget(uint64_t limit = unlimited);
+        MemoryBudget(const MemoryBudget& other) = delete;
+        MemoryBudget& operator=(const MemoryBudget& other) = delete;
+
+        // Counts `bytes` as in use, or throws BudgetExceeded and counts nothing.
+        void reserve(uint64_t bytes);
+        void release(uint64_t bytes);
+        // Whether `bytes` more would fit now.
+        bool admits(uint64_t bytes) const;
+        // Throws BudgetExceeded unless `bytes` more would fit now; counts nothing.
+        void require(uint64_t bytes) const;
+        // A limit below the bytes in use only refuses what comes next; nothing is freed.
+        void setLimit(uint64_t limit);
+        uint64_t limit() const;
+        uint64_t live() const;
+        // The most bytes in use at once since construction or resetPeak().
+        uint64_t peak() const;
+        void resetPeak();
+
+        static MemoryBudget& process();
+
+    private:
+        std::atomic<uint64_t> limitBytes;
+        std::atomic<uint64_t> liveBytes;
+        std::atomic<uint64_t> peakBytes;
+    };
+
+    // Hands out the memory behind pixel buffers and Arrays. The library uses a PoolAllocator by
+    // default, so the tiles freed by one frame are reused by the next; a host application can
+    // install its own, e.g. to draw from a preallocated region.
+    class Allocator {
+    public:
+        virtual ~Allocator() = default;
+        // Memory aligned for any pixel value, or std::bad_alloc.
+        virtual void* allocate(size_t bytes) = 0;
+        // Takes back memory from allocate(), with the size it was asked for.
+        virtual void deallocate(void* memory, size_t bytes) = 0;
+
+        static std::shared_ptr<Allocator> get();
+        // nullptr restores the built-in pool. Memory already handed out still goes back to the
+        // allocator it came from.
+        static void set(std::shared_ptr<Allocator> allocator);
+        // Room for `count` values from the installed allocator, bookkeeping included, returned to
+        // it when the last owner lets go. The values are left uninitialized. Charged to the
+        // process budget and to `budget`, if any, until then.
+        template<typename T>
+        static std::shared_ptr<T[]> share(size_t count, const std::shared_ptr<MemoryBudget>& budget = nullptr);
+
+        // Lets standard containers and shared_ptr control blocks draw from an Allocator.
+        template<typename T>
+        class Adapter {
+        public:
+            using value_type = T;
+
+            explicit Adapter(std::shared_ptr<Allocator> allocator) : allocator(std::move(allocator)) { }
+            template<typename U>
+            Adapter(const Adapter<U>& other) : allocator(other.allocator) { }
+
+            T* allocate(size_t count) {
+                return static_cast<T*>(allocator->allocate(count * sizeof(T)));
+            }
+            void deallocate(T* values, size_t count) {
+                allocator->deallocate(values, count * sizeof(T));
+            }
+            template<typename U>
+            bool operator==(const Adapter<U>& other) const {
+                return allocator == other.allocator;
+            }
+            template<typename U>
+            bool operator!=(const Adapter<U>& other) const {
+                return allocator != other.allocator;
+            }
+
+            std::shared_ptr<Allocator> allocator;
+        };
+    };
+
+    // Plain operator new and delete.
+    class HeapAllocator : public Allocator {
+    public:
+        void* allocate(size_t bytes) override;
+        void deallocate(void* memory, size_t bytes) override;
+    };
+
+    // Keeps freed blocks in size classes, four per power of two, and hands them out again to
+    // requests of the same class, so rendering frames of one size reaches a steady state that
+    // no longer calls into the heap. A request is rounded up by at most a quarter.
+    class PoolAllocator : public Allocator {
+    public:
+        // Blocks freed while `retainedBytes` are already kept go straight back to the heap.
+        explicit PoolAllocator(size_t retainedBytes = 64 << 20);
+        PoolAllocator(const PoolAllocator& other) = delete;
+        PoolAllocator& operator=(const PoolAllocator& other) = delete;
+        ~PoolAllocator() override;
+
+        void* allocate(size_t bytes) override;
+        void deallocate(void* memory, size_t bytes) override;
+        // Bytes of free blocks kept for reuse.
+        size_t retained() const;
+        // Returns every kept block to the heap.
+        void trim();
+        static size_t sizeClass(size_t bytes);
+
+    private:
+        size_t limit;
+        size_t held = 0;
+        std::map<size_t, std::vector<void*>> blocks;
+        mutable std::mutex mutex;
+    };
+
+    // Bump allocator for temporaries that live no longer than one draw call. Every thread has
+    // its own through local(); a Scope rewinds it on exit, and the blocks stay with the arena,
+    // charged to the process budget, so once they have grown to the largest call, drawing takes
+    // no memory from the heap:
+    //
+    //     Arena::Scope scratch;
+    //     Color* ramp = Arena::local().allocate<Color>(length);
+    class Arena {
+    public:
+        class Scope {
+        public:
+            explicit Scope(Arena& arena = Arena::local());
+            Scope(const Scope& other) = delete;
+            Scope& operator=(const Scope& other) = delete;
+            // Releases everything allocated since construction.
+            ~Scope();
+
+        private:
+            Arena& arena;
+            size_t block;
+            size_t used;
+        };
+
+        explicit Arena(size_t blockSize = 64 << 10);
+        Arena(const Arena& other) = delete;
+        Arena& operator=(const Arena& other) = delete;
+        ~Arena();
+
+        void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+        // `count` default-constructed values; they are never destroyed, only reclaimed.
+        template<typename T>
+        T* allocate(size_t count);
+        // Bytes of blocks held, used or not.
+        size_t capacity() const;
+
+        static Arena& local();
+
+    private:
+        class Block {
+        public:
+            uint8_t* data;
+            size_t size;
+        };
+
+        size_t blockSize;
+        std::vector<Block> blocks;
+        // Allocation continues at `used` bytes into blocks[current].
+        size_t current = 0;
+        size_t used = 0;
+    };
+
+    template<typename T>
+    std::shared_ptr<T[]> Allocator::share(size_t count, const std::shared_ptr<MemoryBudget>& budget) {
+        static_assert(std::is_trivially_destructible<T>::value, "shared values must be trivially destructible");
+        if (count > static_cast<size_t>(-1) / sizeof(T)) {
+            throw BudgetExceeded(MemoryBudget::unlimited, MemoryBudget::process().live(), MemoryBudget::process().limit());
+        }
+        const size_t bytes = count * sizeof(T);
+        if (budget != nullptr) {
+            budget->reserve(bytes);
+        }
+        std::shared_ptr<Allocator> allocator;
+        T* values = nullptr;
+        try {
+            MemoryBudget::process().reserve(bytes);
+            try {
+                allocator = get();
+                values = static_cast<T*>(allocator->allocate(bytes));
+            } catch (...) {
+                MemoryBudget::process().release(bytes);
+                throw;
+            }
+        } catch (...) {
+            if (budget != nullptr) {
+                budget->release(bytes);
+            }
+            throw;
+        }
+        // Should the control block fail to allocate, shared_ptr runs the deleter itself.
+        return std::shared_ptr<T[]>(values, [allocator, budget, bytes](T* values) {
+            allocator->deallocate(values, bytes);
+            MemoryBudget::process().release(bytes);
+            if (budget != nullptr) {
+                budget->release(bytes);
+            }
+        }, Adapter<T>(allocator));
+    }
+
+    template<typename T>
+    T* Arena::allocate(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena values must be trivially destructible");
+        if (count > static_cast<size_t>(-1) / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        T* values = static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        std::uninitialized_value_construct_n(values, count);
+        return values;
+    }
+}
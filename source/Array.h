@@ -1,66 +1,67 @@
 #pragma once
+#include "Allocator.h"
 #include <cstdint>
 #include <algorithm>
 #include <cstring>
+#include <memory>
+#include <new>
 #include <stdexcept>
 
 namespace sglib {
     template<typename T>
     class Array {
     public:
-        Array() : arraySize(0) { }
-        explicit Array(size_t size) : arraySize(size) {
-            values = new T[size];
-            memset(values, 0, sizeof(T) * arraySize);
+        Array() : values(nullptr), arraySize(0) { }
+        explicit Array(size_t size) : values(allocate(size)), arraySize(size) {
+            std::uninitialized_default_construct_n(values, size);
+            memset(static_cast<void*>(values), 0, sizeof(T) * arraySize);
         }
 
-        Array(size_t size, const T& value) : arraySize(size) {
-            values = new T[size];
-            for (size_t i = 0; i < size; i++) {
-                values[i] = value;
-            }
+        Array(size_t size, const T& value) : values(allocate(size)), arraySize(size) {
+            std::uninitialized_fill_n(values, size, value);
         }
 
-        Array(std::initializer_list<T> list) : arraySize(list.size()) {
-            values = new T[list.size()];
-            size_t index = 0;
-            for(const auto& i : list) {
-                values[index] = i;
-                index++;
-            }
+        Array(std::initializer_list<T> list) : values(allocate(list.size())), arraySize(list.size()) {
+            std::uninitialized_copy(list.begin(), list.end(), values);
         }
 
-        Array(const Array& other) : arraySize(other.arraySize) {
-            values = new T[other.arraySize];
-            std::copy_n(other.values, other.arraySize, values);
+        Array(const Array& other) : values(allocate(other.arraySize)), arraySize(other.arraySize) {
+            std::uninitialized_copy_n(other.values, other.arraySize, values);
         }
 
-        Array(Array&& other) noexcept : arraySize(other.arraySize) {
-            values = other.values;
+        Array(Array&& other) noexcept : allocator(std::move(other.allocator)), values(other.values),
+                                        arraySize(other.arraySize) {
             other.values = nullptr;
             other.arraySize = 0;
         }
 
+        // Both assignments release the values held before, the copy only once the new ones are in place.
         Array& operator=(const Array& other) {
-            if (this == &other) {
-                return *this;
+            if (this != &other) {
+                Array copy(other);
+                swap(copy);
             }
-            values = new T[other.arraySize];
-            arraySize = other.arraySize;
-            std::copy_n(other.values, other.arraySize, values);
             return *this;
         }
 
         Array& operator=(Array&& other) noexcept {
-            arraySize = other.arraySize;
-            values = other.values;
-            other.values = nullptr;
-            other.arraySize = 0;
+            Array moved(std::move(other));
+            swap(moved);
             return *this;
         }
 
+        void swap(Array& other) noexcept {
+            std::swap(values, other.values);
+            std::swap(arraySize, other.arraySize);
+            std::swap(allocator, other.allocator);
+        }
+
         ~Array() {
-            delete[] values;
+            if (values != nullptr) {
+                std::destroy_n(values, arraySize);
+                allocator->deallocate(values, sizeof(T) * arraySize);
+                MemoryBudget::process().release(sizeof(T) * arraySize);
+            }
         }
 
         const T& operator[](size_t index) const {
@@ -86,7 +87,28 @@ namespace sglib {
         }
 
     private:
+        // Where `values` came from, so they go back there even if another Allocator is installed
+        // since. Declared first: the constructors set it while allocating `values`.
+        std::shared_ptr<Allocator> allocator;
         T* values;
         size_t arraySize;
+
+        T* allocate(size_t size) {
+            if (size == 0) {
+                return nullptr;
+            }
+            if (size > static_cast<size_t>(-1) / sizeof(T)) {
+                throw BudgetExceeded(MemoryBudget::unlimited, MemoryBudget::process().live(),
+                                     MemoryBudget::process().limit());
+            }
+            MemoryBudget::process().reserve(sizeof(T) * size);
+            try {
+                allocator = Allocator::get();
+                return static_cast<T*>(allocator->allocate(sizeof(T) * size));
+            } catch (...) {
+                MemoryBudget::process().release(sizeof(T) * size);
+                throw;
+            }
+        }
     };
 }
\ No newline at end of file
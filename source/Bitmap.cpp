@@ -1,11 +1,17 @@
 #include "Bitmap.h"
+#include "Executor.h"
 #include <fstream>
 #include <cstring>
 #include <stdexcept>
 #include <algorithm>
+#include <vector>
 
 using namespace sglib;
 
+namespace {
+    const size_t batchBytes = 1 << 22;
+}
+
 Bitmap::Header::Header(uint8_t headerSize) {
     bytes = new uint8_t[headerSize];
     std::memset(bytes, 0, headerSize);
@@ -35,6 +41,10 @@ Bitmap::Header::Header(Bitmap::Header&& other) noexcept :
 }
 
 Bitmap::Header &Bitmap::Header::operator=(Bitmap::Header&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    delete[] bytes;
     hSize = other.hSize;
     other.hSize = 0;
     bytes = other.bytes;
@@ -46,9 +56,11 @@ Bitmap::Header &Bitmap::Header::operator=(const Bitmap::Header& other) {
     if (this == &other) {
         return *this;
     }
+    auto* copy = new uint8_t[other.hSize];
+    std::copy_n(other.bytes, other.hSize, copy);
+    delete[] bytes;
+    bytes = copy;
     hSize = other.hSize;
-    bytes = new uint8_t[hSize];
-    std::copy_n(other.bytes, hSize, bytes);
     return *this;
 }
 
@@ -172,16 +184,25 @@ const Pixels& Bitmap::getPixels() const {
     return pixelsData;
 }
 
-void Bitmap24::read() {
-    std::ifstream file(filePath, std::ios::in | std::ios::binary);
-    if (!file.is_open()){
-        throw std::invalid_argument("cannot open the file");
-    }
+const RenderStats& Bitmap::stats() const {
+    return statistics;
+}
+
+void Bitmap::put(std::ostream& file, const void* data, size_t size) {
+    file.write(static_cast<const char*>(data), static_cast<int64_t>(size));
+    statistics.countTransfer(RenderStats::Codec::Encode, size);
+}
 
+void Bitmap::take(std::istream& file, void* data, size_t size) {
+    file.read(static_cast<char*>(data), static_cast<int64_t>(size));
+    statistics.countTransfer(RenderStats::Codec::Decode, size);
+}
+
+void Bitmap::readHeaders(std::istream& file, uint8_t bytesPerPixel) {
     char fileHeaderArray[FileHeader::headerSize];
     char informationHeaderArray[InformationHeader::headerSize];
-    file.read(fileHeaderArray, FileHeader::headerSize);
-    file.read(informationHeaderArray, InformationHeader::headerSize);
+    take(file, fileHeaderArray, FileHeader::headerSize);
+    take(file, informationHeaderArray, InformationHeader::headerSize);
 
     auto* fileHeaderPtr = reinterpret_cast<uint8_t*>(fileHeaderArray);
     auto* informationHeaderPtr = reinterpret_cast<uint8_t*>(informationHeaderArray);
@@ -189,138 +210,204 @@ void Bitmap24::read() {
     fileHeader = FileHeader(fileHeaderPtr);
     informationHeader = InformationHeader(informationHeaderPtr);
 
-    const int32_t startOfPixelArray = fileHeader.startOfPixelArray();
-    const int32_t width = informationHeader.width();
-    const int32_t height = informationHeader.height();
-    const uint8_t bytesPerPixel = informationHeader.bytesPerPixel();
-
-    const size_t paddingSize = (4 - (width * 3) % 4) % 4;
-
-    if (bytesPerPixel != 3) {
-        throw std::runtime_error("supports only 24-bit format");
+    if (informationHeader.bytesPerPixel() != bytesPerPixel) {
+        throw std::runtime_error("supports only " + std::to_string(bytesPerPixel * 8) + "-bit format");
     }
+}
 
-    pixelsData = Pixels(width, height);
-    file.seekg(startOfPixelArray, std::ios::beg);
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            char values[3];
-            file.read(values, 3);
-            auto b = static_cast<uint8_t>(values[0]);
-            auto g = static_cast<uint8_t>(values[1]);
-            auto r = static_cast<uint8_t>(values[2]);
-            pixelsData.set(x, y, Color(Color::Rgb(r, g, b)));
-        }
-
-        file.ignore(static_cast<int64_t>(paddingSize));
+std::ifstream Bitmap::open(uint8_t bytesPerPixel) {
+    std::ifstream file(filePath, std::ios::in | std::ios::binary);
+    if (!file.is_open()){
+        throw std::invalid_argument("cannot open the file");
     }
-    file.close();
+    readHeaders(file, bytesPerPixel);
+    file.seekg(fileHeader.startOfPixelArray(), std::ios::beg);
+    statistics.countTransfer(RenderStats::Codec::Decode, 0);
+    return file;
 }
 
-void Bitmap32::read() {
-    std::ifstream file(filePath, std::ios::in | std::ios::binary);
+std::fstream Bitmap::modify(size_t width, size_t height, uint8_t bytesPerPixel) {
+    std::fstream file(filePath, std::ios::in | std::ios::out | std::ios::binary);
     if (!file.is_open()){
         throw std::invalid_argument("cannot open the file");
     }
+    readHeaders(file, bytesPerPixel);
+    if (informationHeader.width() != static_cast<int32_t>(width) ||
+        informationHeader.height() != static_cast<int32_t>(height)) {
+        throw std::runtime_error("bitmap dimensions do not match");
+    }
+    return file;
+}
 
-    char fileHeaderArray[FileHeader::headerSize];
-    char informationHeaderArray[InformationHeader::headerSize];
-    file.read(fileHeaderArray, FileHeader::headerSize);
-    file.read(informationHeaderArray, InformationHeader::headerSize);
+std::ofstream Bitmap::create(size_t width, size_t height, uint8_t bytesPerPixel) {
+    std::ofstream file(filePath, std::ios::out | std::ios::binary);
+    if (!file.is_open()){
+        throw std::invalid_argument("cannot create the file");
+    }
+    writeHeaders(file, width, height, bytesPerPixel);
+    return file;
+}
 
-    auto* fileHeaderPtr = reinterpret_cast<uint8_t*>(fileHeaderArray);
-    auto* informationHeaderPtr = reinterpret_cast<uint8_t*>(informationHeaderArray);
+void Bitmap::writeHeaders(std::ostream& file, size_t width, size_t height, uint8_t bytesPerPixel) {
+    const uint8_t fileHeaderSize = FileHeader::headerSize;
+    const uint8_t informationHeaderSize = InformationHeader::headerSize;
 
-    fileHeader = FileHeader(fileHeaderPtr);
-    informationHeader = InformationHeader(informationHeaderPtr);
+    const auto fileSize = static_cast<int32_t>(fileHeaderSize +
+        informationHeaderSize + stride(width, bytesPerPixel) * height);
 
-    const int32_t startOfPixelArray = fileHeader.startOfPixelArray();
+    informationHeader = InformationHeader(static_cast<int32_t>(width),
+        static_cast<int32_t>(height), bytesPerPixel);
+    fileHeader = FileHeader(fileSize, informationHeaderSize);
+    put(file, fileHeader.getBytes(), fileHeaderSize);
+    put(file, informationHeader.getBytes(), informationHeaderSize);
+}
+
+size_t Bitmap::stride(size_t width, uint8_t bytesPerPixel) {
+    const size_t widthInBytes = width * bytesPerPixel;
+    return widthInBytes + (4 - widthInBytes % 4) % 4;
+}
+
+void Bitmap24::read() {
+    RenderStats::TransferScope scope(statistics, RenderStats::Codec::Decode);
+    std::ifstream file = open(3);
     const int32_t width = informationHeader.width();
     const int32_t height = informationHeader.height();
-    const uint8_t bytesPerPixel = informationHeader.bytesPerPixel();
 
-    if (bytesPerPixel != 4) {
-        throw std::runtime_error("supports only 32-bit format");
+    RgbPixels rgbPixels(width, height);
+    const size_t paddingSize = stride(width, 3) - width * 3;
+    for (int y = 0; y < height; y++) {
+        take(file, rgbPixels.row(y), width * 3);
+        file.ignore(static_cast<int64_t>(paddingSize));
+        statistics.countTransfer(RenderStats::Codec::Decode, paddingSize);
     }
+    file.close();
+    pixelsData = rgbPixels.convert<Rgba32>();
+}
+
+void Bitmap32::read() {
+    RenderStats::TransferScope scope(statistics, RenderStats::Codec::Decode);
+    std::ifstream file = open(4);
+    const int32_t width = informationHeader.width();
+    const int32_t height = informationHeader.height();
 
     pixelsData = Pixels(width, height);
-    file.seekg(startOfPixelArray, std::ios::beg);
     for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            char values[4];
-            file.read(values, 4);
-            auto b = static_cast<uint8_t>(values[0]);
-            auto g = static_cast<uint8_t>(values[1]);
-            auto r = static_cast<uint8_t>(values[2]);
-            auto a = static_cast<uint8_t>(values[3]);
-            pixelsData.set(x, y, Color(Color::Rgb(r, g, b), a));
-        }
+        take(file, pixelsData.row(y), width * 4);
     }
     file.close();
 }
 
+void Bitmap::keep(const Pixels& pixels) {
+    // Caller memory may be released as soon as write/update returns, so it is not held on to.
+    pixelsData = pixels.external() ? Pixels() : pixels;
+}
 
 void Bitmap24::write(const Pixels& pixels) {
-    std::ofstream file(filePath, std::ios::out | std::ios::binary);
-    if (!file.is_open()){
-        throw std::invalid_argument("cannot create the file");
-    }
-    pixelsData = pixels;
-    const uint8_t fileHeaderSize = FileHeader::headerSize;
-    const uint8_t informationHeaderSize = InformationHeader::headerSize;
-
-    const size_t widthInBytes = pixelsData.width() * 3;
-    const size_t paddingSize = (4 - (widthInBytes) % 4) % 4;
-    uint8_t padding[3] = {0, 0, 0};
-
-    const size_t stride = widthInBytes + paddingSize;
+    RenderStats::TransferScope scope(statistics, RenderStats::Codec::Encode);
+    keep(pixels);
+    std::ofstream file = create(pixels.width(), pixels.height(), 3);
+    writeRows(file, pixels, 0, pixels.height());
+    file.close();
+}
 
-    const auto fileSize = static_cast<int32_t>(fileHeaderSize +
-        informationHeaderSize + stride * pixelsData.height());
+void Bitmap24::write(const Pixels& pixels, std::ostream& out) {
+    RenderStats::TransferScope scope(statistics, RenderStats::Codec::Encode);
+    keep(pixels);
+    writeHeaders(out, pixels.width(), pixels.height(), 3);
+    writeRows(out, pixels, 0, pixels.height());
+}
 
-    informationHeader = InformationHeader(static_cast<int32_t>(pixelsData.width()),
-        static_cast<int32_t>(pixelsData.height()), 3);
-    fileHeader = FileHeader(fileSize, informationHeaderSize);
-    file.write(reinterpret_cast<const char*>(fileHeader.getBytes()), fileHeaderSize);
-    file.write(reinterpret_cast<const char*>(informationHeader.getBytes()), informationHeaderSize);
-    for (int y = 0; y < pixelsData.height(); y++) {
-        for (int x = 0; x < pixelsData.width(); x++) {
-            Color::Rgb rgb = pixelsData.get(x, y).getRgb();
-            uint8_t values[] = {rgb.blue, rgb.green, rgb.red};
-            file.write(reinterpret_cast<const char*>(values), 3);
-        }
-        file.write(reinterpret_cast<char*>(padding), static_cast<int64_t>(paddingSize));
+void Bitmap24::write(const RgbPixels& pixels) {
+    RenderStats::TransferScope scope(statistics, RenderStats::Codec::Encode);
+    std::ofstream file = create(pixels.width(), pixels.height(), 3);
+    const size_t paddingSize = stride(pixels.width(), 3) - pixels.width() * 3;
+    uint8_t padding[3] = {0, 0, 0};
+    for (size_t y = 0; y < pixels.height(); y++) {
+        put(file, pixels.row(y), pixels.width() * 3);
+        put(file, padding, paddingSize);
     }
     file.close();
 }
 
-void Bitmap32::write(const Pixels& pixels) {
-    std::ofstream file(filePath, std::ios::out | std::ios::binary);
-    if (!file.is_open()){
-        throw std::invalid_argument("cannot create the file");
+void Bitmap24::update(const Pixels& pixels) {
+    RenderStats::TransferScope scope(statistics, RenderStats::Codec::Encode);
+    std::fstream file = modify(pixels.width(), pixels.height(), 3);
+    keep(pixels);
+    for (const auto& range : pixels.dirtyRanges()) {
+        file.seekp(static_cast<int64_t>(fileHeader.startOfPixelArray() +
+                                        range.first * stride(pixels.width(), 3)), std::ios::beg);
+        statistics.countTransfer(RenderStats::Codec::Encode, 0);
+        writeRows(file, pixels, range.first, range.second);
     }
-    pixelsData = pixels;
-    const uint8_t fileHeaderSize = FileHeader::headerSize;
-    const uint8_t informationHeaderSize = InformationHeader::headerSize;
+    file.close();
+}
 
-    const size_t widthInBytes = pixelsData.width() * 4;
+void Bitmap24::writeRows(std::ostream& file, const Pixels& pixels, size_t begin, size_t end) {
+    // Rows are converted a batch at a time, in parallel bands, and each batch is written at once.
+    // The buffer starts zeroed and only pixel bytes are overwritten, so the padding stays zero.
+    const size_t rowSize = stride(pixels.width(), 3);
+    // Rows of an image without columns take no bytes, and it has no row() to read them from.
+    if (rowSize == 0) {
+        return;
+    }
+    const size_t batch = std::max<size_t>(1, batchBytes / rowSize);
+    std::vector<uint8_t> buffer(std::min(end - begin, batch) * rowSize);
+    for (size_t first = begin; first < end; first += batch) {
+        const size_t last = std::min(end, first + batch);
+        Executor::parallelFor(first, last, (last - first) * pixels.width(), [&](size_t from, size_t to) {
+            const Color* previous = nullptr;
+            const uint8_t* converted = nullptr;
+            for (size_t y = from; y < to; y++) {
+                uint8_t* row = buffer.data() + (y - first) * rowSize;
+                // Untouched rows all share the background row, so it is converted only once; rows
+                // repeating the one before, as in contiguous storage, are copied the same way.
+                if (pixels.row(y) == previous ||
+                    (previous != nullptr && std::memcmp(pixels.row(y), previous, pixels.width() * sizeof(Color)) == 0)) {
+                    std::copy_n(converted, pixels.width() * 3, row);
+                    continue;
+                }
+                previous = pixels.row(y);
+                converted = row;
+                FormatConverter<Rgba32, Rgb24>::convert(previous, reinterpret_cast<Color::Rgb*>(row), pixels.width());
+            }
+        });
+        put(file, buffer.data(), (last - first) * rowSize);
+    }
+}
 
-    const auto fileSize = static_cast<int32_t>(fileHeaderSize +
-                                               informationHeaderSize + widthInBytes * pixelsData.height());
+void Bitmap32::write(const Pixels& pixels) {
+    RenderStats::TransferScope scope(statistics, RenderStats::Codec::Encode);
+    keep(pixels);
+    std::ofstream file = create(pixels.width(), pixels.height(), 4);
+    writeRows(file, pixels, 0, pixels.height());
+    file.close();
+}
 
-    informationHeader = InformationHeader(static_cast<int32_t>(pixelsData.width()),
-                                          static_cast<int32_t>(pixelsData.height()), 4);
-    fileHeader = FileHeader(fileSize, informationHeaderSize);
+void Bitmap32::write(const Pixels& pixels, std::ostream& out) {
+    RenderStats::TransferScope scope(statistics, RenderStats::Codec::Encode);
+    keep(pixels);
+    writeHeaders(out, pixels.width(), pixels.height(), 4);
+    writeRows(out, pixels, 0, pixels.height());
+}
 
-    file.write(reinterpret_cast<const char*>(fileHeader.getBytes()), fileHeaderSize);
-    file.write(reinterpret_cast<const char*>(informationHeader.getBytes()), informationHeaderSize);
-    for (int y = 0; y < pixelsData.height(); y++) {
-        for (int x = 0; x < pixelsData.width(); x++) {
-            Color::Rgb rgb = pixelsData.get(x, y).getRgb();
-            uint8_t values[] = {rgb.blue, rgb.green, rgb.red, pixelsData.get(x, y).a()};
-            file.write(reinterpret_cast<const char*>(values), 4);
-        }
+void Bitmap32::update(const Pixels& pixels) {
+    RenderStats::TransferScope scope(statistics, RenderStats::Codec::Encode);
+    std::fstream file = modify(pixels.width(), pixels.height(), 4);
+    keep(pixels);
+    for (const auto& range : pixels.dirtyRanges()) {
+        file.seekp(static_cast<int64_t>(fileHeader.startOfPixelArray() +
+                                        range.first * stride(pixels.width(), 4)), std::ios::beg);
+        statistics.countTransfer(RenderStats::Codec::Encode, 0);
+        writeRows(file, pixels, range.first, range.second);
     }
     file.close();
+}
+
+void Bitmap32::writeRows(std::ostream& file, const Pixels& pixels, size_t begin, size_t end) {
+    if (pixels.empty()) {
+        return;
+    }
+    for (size_t y = begin; y < end; y++) {
+        put(file, pixels.row(y), pixels.width() * 4);
+    }
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <utility>
 #include "Color.h"
 #include "Pixels.h"
+#include "Stats.h"
 
 namespace sglib {
     class Bitmap {
@@ -17,9 +18,17 @@ namespace sglib {
         explicit Bitmap(const Bitmap& other) = delete;
         Bitmap& operator=(const Bitmap& other) = delete;
         virtual void write(const Pixels& pixels) = 0;
+        // Encodes the whole file into `out`, e.g. a std::ostringstream, instead of the path.
+        virtual void write(const Pixels& pixels, std::ostream& out) = 0;
+        // Rewrites only the rows marked dirty in `pixels`, in place, in an existing file
+        // previously written with the same dimensions and format.
+        virtual void update(const Pixels& pixels) = 0;
         virtual void read() = 0;
         virtual ~Bitmap() = default;
+        // The pixels last read or written; empty after writing pixels over external memory.
         const Pixels& getPixels() const;
+        // Encode and decode counters of this bitmap; see RenderStats.
+        const RenderStats& stats() const;
 
     protected:
         class Header {
@@ -61,10 +70,22 @@ namespace sglib {
             uint8_t bytesPerPixel() const;
         };
 
+        void readHeaders(std::istream& file, uint8_t bytesPerPixel);
+        std::ifstream open(uint8_t bytesPerPixel);
+        std::fstream modify(size_t width, size_t height, uint8_t bytesPerPixel);
+        std::ofstream create(size_t width, size_t height, uint8_t bytesPerPixel);
+        void writeHeaders(std::ostream& file, size_t width, size_t height, uint8_t bytesPerPixel);
+        static size_t stride(size_t width, uint8_t bytesPerPixel);
+        void keep(const Pixels& pixels);
+        // Stream reads and writes that are counted in stats().
+        void put(std::ostream& file, const void* data, size_t size);
+        void take(std::istream& file, void* data, size_t size);
+
         std::string filePath;
         FileHeader fileHeader;
         InformationHeader informationHeader;
         Pixels pixelsData;
+        RenderStats statistics;
     };
 
     class Bitmap24 : public Bitmap {
@@ -74,8 +95,14 @@ namespace sglib {
         Bitmap24& operator=(const Bitmap24& other) = delete;
 
         void write(const Pixels& pixels) override;
+        void write(const Pixels& pixels, std::ostream& out) override;
+        void write(const RgbPixels& pixels);
+        void update(const Pixels& pixels) override;
         void read() override;
         ~Bitmap24() override = default;
+
+    private:
+        void writeRows(std::ostream& file, const Pixels& pixels, size_t begin, size_t end);
     };
 
     class Bitmap32 : public Bitmap {
@@ -85,7 +112,12 @@ namespace sglib {
         Bitmap32& operator=(const Bitmap32& other) = delete;
 
         void write(const Pixels& pixels) override;
+        void write(const Pixels& pixels, std::ostream& out) override;
+        void update(const Pixels& pixels) override;
         void read() override;
         ~Bitmap32() override = default;
+
+    private:
+        void writeRows(std::ostream& file, const Pixels& pixels, size_t begin, size_t end);
     };
 }
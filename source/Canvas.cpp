@@ -1,22 +1,47 @@
 #include "Canvas.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 #include <stdexcept>
 #include "Shape.h"
 
 using namespace sglib;
 
-void Canvas::draw(const std::string& out, Bitmap::Type type) {
-    Bitmap* bitmap = nullptr;
+std::unique_ptr<Bitmap> Canvas::createBitmap(const std::string& out, Bitmap::Type type) {
     if (type == Bitmap::Type::bit24) {
-        bitmap = new Bitmap24(out);
+        return std::unique_ptr<Bitmap>(new Bitmap24(out));
     } else if(type == Bitmap::Type::bit32) {
-        bitmap = new Bitmap32(out);
-    } else {
-        throw std::runtime_error("unsupported bitmap type");
+        return std::unique_ptr<Bitmap>(new Bitmap32(out));
     }
+    throw std::runtime_error("unsupported bitmap type");
+}
 
+void Canvas::draw(const std::string& out, Bitmap::Type type) {
+    std::unique_ptr<Bitmap> bitmap = createBitmap(out, type);
     bitmap->write(pixels);
+#ifdef SGLIB_STATS
+    statistics += bitmap->stats();
+#endif
+    pixels.checkpoint();
+}
+
+void Canvas::draw(std::ostream& out, Bitmap::Type type) {
+    std::unique_ptr<Bitmap> bitmap = createBitmap(std::string(), type);
+    bitmap->write(pixels, out);
+#ifdef SGLIB_STATS
+    statistics += bitmap->stats();
+#endif
+    pixels.checkpoint();
+}
 
-    delete bitmap;
+void Canvas::redraw(const std::string& out, Bitmap::Type type) {
+    std::unique_ptr<Bitmap> bitmap = createBitmap(out, type);
+    bitmap->update(pixels);
+#ifdef SGLIB_STATS
+    statistics += bitmap->stats();
+#endif
+    pixels.checkpoint();
 }
 
 Pixels& Canvas::get() {
@@ -27,6 +52,171 @@ const Pixels& Canvas::get() const {
     return pixels;
 }
 
+Canvas Canvas::snapshot() const {
+    return Canvas(pixels.snapshot(), antialiased, clips);
+}
+
+Canvas& Canvas::setAntialiasing(bool enabled) {
+    antialiased = enabled;
+    return *this;
+}
+
+bool Canvas::antialiasing() const {
+    return antialiased;
+}
+
+Canvas& Canvas::pushClip(Point<float> lowerBound, Point<float> upperBound) {
+    Point<size_t> lower, upper;
+    pixels.getClip(lower, upper);
+    clips.emplace_back(lower, upper);
+    auto toIndex = [](float value) {
+        return static_cast<size_t>(std::max(0.0f, ceilf(value)));
+    };
+    pixels.setClip({std::max(lower.x(), toIndex(lowerBound.x())), std::max(lower.y(), toIndex(lowerBound.y()))},
+                   {std::min(upper.x(), toIndex(upperBound.x())), std::min(upper.y(), toIndex(upperBound.y()))});
+    return *this;
+}
+
+Canvas& Canvas::popClip() {
+    if (clips.empty()) {
+        throw std::out_of_range("clip stack is empty");
+    }
+    pixels.setClip(clips.back().first, clips.back().second);
+    clips.pop_back();
+    return *this;
+}
+
+RenderStats& Canvas::stats() {
+    return statistics;
+}
+
+const RenderStats& Canvas::stats() const {
+    return statistics;
+}
+
+Canvas& Canvas::setOverdrawTracking(bool enabled) {
+    pixels.trackWrites(enabled);
+    return *this;
+}
+
+bool Canvas::overdrawTracking() const {
+    return pixels.trackingWrites();
+}
+
+Canvas::Overdraw Canvas::overdraw() const {
+    Overdraw result{0, 0, 0.0, 0, 0.0};
+    if (!pixels.trackingWrites()) {
+        return result;
+    }
+    size_t repeated = 0;
+    for (size_t y = 0; y < pixels.height(); y++) {
+        for (size_t x = 0; x < pixels.width(); x++) {
+            const uint32_t writes = pixels.writes(x, y);
+            result.writes += writes;
+            result.pixels += writes > 0;
+            result.maximum = std::max(result.maximum, writes);
+            repeated += writes > 1;
+        }
+    }
+    if (result.pixels > 0) {
+        result.average = static_cast<double>(result.writes) / static_cast<double>(result.pixels);
+        result.repeated = static_cast<double>(repeated) * 100.0 / static_cast<double>(result.pixels);
+    }
+    return result;
+}
+
+Canvas Canvas::heatmap() const {
+    const Color stops[] = {Color::black, Color::blue, Color::green, Color::yellow, Color::red};
+    // Index i holds the color for i writes; counts past the end use the last entry.
+    std::vector<Color> palette(stops, stops + 5);
+    for (uint32_t writes = 5; writes <= 8; writes++) {
+        Color color = Color::red;
+        Rgba32::blend(color, Color::white, static_cast<uint8_t>((writes - 4) * 255 / 4));
+        palette.push_back(color);
+    }
+    Pixels result(pixels.width(), pixels.height(), Color::black);
+    if (!pixels.trackingWrites()) {
+        return Canvas(std::move(result), false, {});
+    }
+    for (size_t y = 0; y < pixels.height(); y++) {
+        Color* line = result.row(y);
+        for (size_t x = 0; x < pixels.width(); x++) {
+            line[x] = palette[std::min<size_t>(pixels.writes(x, y), palette.size() - 1)];
+        }
+    }
+    return Canvas(std::move(result), false, {});
+}
+
+Canvas Canvas::layer() const {
+    Canvas result(Pixels(pixels.width(), pixels.height(), Color(Color::Rgb(), 0), Pixels::Storage::Tiled,
+                         pixels.budget()),
+                  antialiased, clips);
+    Point<size_t> lower, upper;
+    pixels.getClip(lower, upper);
+    result.pixels.setClip(lower, upper);
+    result.pixels.checkpoint();
+    return result;
+}
+
+Canvas& Canvas::merge(const Canvas& layer) {
+    std::vector<const Canvas*> layers = {&layer};
+    return merge(layers.data(), layers.size());
+}
+
+Canvas& Canvas::merge(const std::vector<Canvas>& layers) {
+    std::vector<const Canvas*> pointers;
+    for (const auto& layer : layers) {
+        pointers.push_back(&layer);
+    }
+    return merge(pointers.data(), pointers.size());
+}
+
+Canvas& Canvas::merge(const Canvas* const* layers, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (layers[i]->width() != width() || layers[i]->height() != height()) {
+            throw std::invalid_argument("layer size differs from the canvas");
+        }
+    }
+    // Each band takes its rows from every layer in turn, so the stacking order is the same
+    // in every band, and bands own their rows of this canvas.
+    auto rows = [&](size_t first, size_t last) {
+        for (size_t i = 0; i < count; i++) {
+            const Pixels& source = layers[i]->pixels;
+            const bool clear = source.background().a() == 0;
+            for (size_t y = first; y < last; y++) {
+                // Rows never drawn into read as the background, and leave nothing to composite
+                // when it is transparent, as a layer's is.
+                if (clear && !source.materialized(y)) {
+                    continue;
+                }
+                const Color* line = source.row(y);
+                const auto row = static_cast<int64_t>(y);
+                for (size_t x = 0; x < width();) {
+                    const uint8_t alpha = line[x].a();
+                    if (alpha == 0) {
+                        x++;
+                    } else if (alpha == 255) {
+                        size_t end = x + 1;
+                        while (end < width() && line[end].a() == 255) {
+                            end++;
+                        }
+                        pixels.copySpan(row, static_cast<int64_t>(x), static_cast<int64_t>(end), line + x);
+                        x = end;
+                    } else {
+                        pixels.blend(static_cast<int64_t>(x), row, line[x], 255);
+                        x++;
+                    }
+                }
+            }
+        }
+    };
+    pixels.parallelRows(0, height(), width() * height() * count, std::ref(rows));
+    for (size_t i = 0; i < count; i++) {
+        statistics += layers[i]->statistics;
+    }
+    return *this;
+}
+
 size_t Canvas::width() const {
     return pixels.width();
 }
@@ -35,26 +225,172 @@ size_t Canvas::height() const {
     return pixels.height();
 }
 
-Canvas& Canvas::addLine(Point<float> start, Point<float> finish, const Color& color) {
+Canvas& Canvas::addLine(Point<float> start, Point<float> finish, const Color& color, const Stroke& stroke) {
     Line line(*this, color, start, finish);
-    return line.draw();
+    return line.draw(stroke);
 }
 
-Canvas& Canvas::addEllipse(Point<float> lowerBound, Point<float> upperBound, const Color &color) {
+Canvas& Canvas::addEllipse(Point<float> lowerBound, Point<float> upperBound, const Color &color,
+                           const Stroke& stroke) {
     Ellipse ellipse(*this, color, lowerBound, upperBound);
-    return ellipse.draw();
+    return ellipse.draw(stroke);
 }
 
 Canvas& Canvas::fill(const Color& color) {
-    pixels.setRange({0, 0}, {pixels.width(), pixels.height()}, color);
+    RenderStats::Scope scope(statistics, pixels, RenderStats::Primitive::Fill);
+    pixels.fill(color);
+    return *this;
+}
+
+// Scanline fill over runs. A run is painted as soon as it is found and pushed, so painted pixels
+// stop matching and each pixel enters the stack at most once; popping a run scans the rows above
+// and below it. Only when the new color itself matches is a visited bitmap needed for that.
+// The stack holds at most floodCapacity runs. Runs found while it is full are marked in a pending
+// bitmap instead, which is swept once the stack drains, so serpentine regions cost one bit per
+// pixel rather than a stack entry per run.
+Canvas& Canvas::floodFill(Point<float> seed, const Color& color, uint8_t tolerance) {
+    RenderStats::Scope scope(statistics, pixels, RenderStats::Primitive::FloodFill);
+    Point<size_t> lower, upper;
+    pixels.getClip(lower, upper);
+    const auto seedX = static_cast<int64_t>(floorf(seed.x()));
+    const auto seedY = static_cast<int64_t>(floorf(seed.y()));
+    if (seedX < static_cast<int64_t>(lower.x()) || seedY < static_cast<int64_t>(lower.y()) ||
+        seedX >= static_cast<int64_t>(upper.x()) || seedY >= static_cast<int64_t>(upper.y())) {
+        return *this;
+    }
+    const Pixels& source = pixels;
+    auto packed = [](const Color& value) {
+        uint32_t result;
+        memcpy(&result, &value, sizeof(result));
+        return result;
+    };
+    const uint32_t target = packed(source.get(seedX, seedY));
+    auto matches = [target, tolerance](uint32_t value) {
+        if (value == target) {
+            return true;
+        }
+        if (tolerance == 0) {
+            return false;
+        }
+        for (int shift = 0; shift < 32; shift += 8) {
+            const int difference = static_cast<int>((value >> shift) & 0xff) - static_cast<int>((target >> shift) & 0xff);
+            if (std::abs(difference) > tolerance) {
+                return false;
+            }
+        }
+        return true;
+    };
+    if (tolerance == 0 && target == packed(color)) {
+        return *this;
+    }
+
+    const size_t width = pixels.width();
+    const bool tracked = matches(packed(color));
+    floodVisited.assign(tracked ? (width * pixels.height() + 63) / 64 : 0, 0);
+    floodPending.clear();
+    bool overflowed = false;
+    auto open = [&](const Color* line, size_t x, size_t y) {
+        if (!tracked) {
+            return matches(packed(line[x]));
+        }
+        const size_t index = y * width + x;
+        return ((floodVisited[index >> 6] >> (index & 63)) & 1) == 0 && matches(packed(line[x]));
+    };
+    auto mark = [width](std::vector<uint64_t>& bits, size_t y, size_t left, size_t right) {
+        for (size_t index = y * width + left; index < y * width + right; index++) {
+            bits[index >> 6] |= static_cast<uint64_t>(1) << (index & 63);
+        }
+    };
+    // Paints and pushes the maximal matching run through (x, y); returns where it ends.
+    auto push = [&](const Color* line, size_t x, size_t y) {
+        size_t left = x;
+        size_t right = x + 1;
+        while (left > lower.x() && open(line, left - 1, y)) {
+            left--;
+        }
+        while (right < upper.x() && open(line, right, y)) {
+            right++;
+        }
+        if (tracked) {
+            mark(floodVisited, y, left, right);
+        }
+        pixels.setSpan(static_cast<int64_t>(y), static_cast<int64_t>(left), static_cast<int64_t>(right), color);
+        if (floodRuns.size() < floodCapacity) {
+            floodRuns.push_back({y, left, right});
+        } else {
+            if (floodPending.empty()) {
+                floodPending.assign((width * pixels.height() + 63) / 64, 0);
+            }
+            mark(floodPending, y, left, right);
+            overflowed = true;
+        }
+        return right;
+    };
+    auto scan = [&](const Run& run) {
+        for (size_t y : {run.y - 1, run.y + 1}) {
+            // run.y - 1 wraps around for the top row and fails the upper check.
+            if (y < lower.y() || y >= upper.y()) {
+                continue;
+            }
+            const Color* line = source.row(y);
+            for (size_t x = run.x0; x < run.x1; x++) {
+                if (open(line, x, y)) {
+                    x = push(line, x, y);
+                    // Painting may have materialized or copied the row.
+                    line = source.row(y);
+                }
+            }
+        }
+    };
+    auto drain = [&]() {
+        while (!floodRuns.empty()) {
+            const Run run = floodRuns.back();
+            floodRuns.pop_back();
+            scan(run);
+        }
+    };
+
+    floodRuns.clear();
+    push(source.row(seedY), seedX, seedY);
+    drain();
+    while (overflowed) {
+        overflowed = false;
+        for (size_t y = lower.y(); y < upper.y(); y++) {
+            for (size_t x = lower.x(); x < upper.x(); x++) {
+                size_t index = y * width + x;
+                if (((floodPending[index >> 6] >> (index & 63)) & 1) == 0) {
+                    continue;
+                }
+                const size_t left = x;
+                for (; x < upper.x() && ((floodPending[index >> 6] >> (index & 63)) & 1) != 0; x++, index++) {
+                    floodPending[index >> 6] &= ~(static_cast<uint64_t>(1) << (index & 63));
+                }
+                scan({y, left, x});
+                drain();
+            }
+        }
+    }
+    return *this;
+}
+
+Canvas& Canvas::clear(const Color& color) {
+    if (pixels.empty() || pixels.storage() != Pixels::Storage::Contiguous || !pixels.materialized(0)) {
+        return fill(color);
+    }
+    RenderStats::Scope scope(statistics, pixels, RenderStats::Primitive::Fill);
+    Point<size_t> lower, upper;
+    pixels.getClip(lower, upper);
+    pixels.setRange(lower, upper, color);
     return *this;
 }
 
 Canvas& Canvas::fill(const LinearGradient& gradient, LinearGradient::Type type) {
+    RenderStats::Scope scope(statistics, pixels, RenderStats::Primitive::Fill);
     gradient.apply(pixels, {0, 0},
                    {static_cast<float>(pixels.width()),
                     static_cast<float>(pixels.height())},
-                   [](size_t i, size_t j){return true;}, type);
+                   [](int64_t) { return std::make_pair<int64_t, int64_t>(0, std::numeric_limits<int64_t>::max()); },
+                   type);
     return *this;
 }
 
@@ -64,9 +400,10 @@ Canvas& Canvas::addFilledEllipse(Point<float> lowerBound, Point<float> upperBoun
     return ellipse.fill();
 }
 
-Canvas& Canvas::addRectangle(Point<float> lowerBound, Point<float> upperBound, const Color& color) {
+Canvas& Canvas::addRectangle(Point<float> lowerBound, Point<float> upperBound, const Color& color,
+                             const Stroke& stroke) {
     Rectangle rectangle(*this, color, lowerBound, upperBound);
-    return rectangle.draw();
+    return rectangle.draw(stroke);
 }
 
 Canvas& Canvas::addFilledRectangle(Point<float> lowerBound, Point<float> upperBound, const Color& color) {
@@ -85,3 +422,68 @@ Canvas& Canvas::addFilledEllipse(Point<float> lowerBound, Point<float> upperBoun
     Ellipse ellipse(*this, Color(Color::Rgb(255, 255, 255)), lowerBound, upperBound);
     return ellipse.fill(gradient, type);
 }
+
+Canvas& Canvas::addFilledEllipse(Point<float> lowerBound, Point<float> upperBound, const Color& color,
+                                 const Transform2D& transform) {
+    Ellipse ellipse(*this, color, lowerBound, upperBound);
+    return ellipse.fill(transform);
+}
+
+Canvas& Canvas::addFilledEllipse(Point<float> lowerBound, Point<float> upperBound, const LinearGradient& gradient,
+                                 LinearGradient::Type type, const Transform2D& transform) {
+    Ellipse ellipse(*this, Color(Color::Rgb(255, 255, 255)), lowerBound, upperBound);
+    return ellipse.fill(gradient, type, transform);
+}
+
+Canvas& Canvas::addFilledRectangle(Point<float> lowerBound, Point<float> upperBound, const Color& color,
+                                   const Transform2D& transform) {
+    Rectangle rectangle(*this, color, lowerBound, upperBound);
+    return rectangle.fill(transform);
+}
+
+Canvas& Canvas::addFilledRectangle(Point<float> lowerBound, Point<float> upperBound,
+                                   const LinearGradient& gradient, LinearGradient::Type type,
+                                   const Transform2D& transform) {
+    Rectangle rectangle(*this, Color(Color::Rgb(255, 255, 255)), lowerBound, upperBound);
+    return rectangle.fill(gradient, type, transform);
+}
+
+Canvas& Canvas::addPolygon(const Array<Point<float>>& points, const Color& color, const Stroke& stroke) {
+    Polygon polygon(*this, color, points);
+    return polygon.draw(stroke);
+}
+
+Canvas& Canvas::addFilledPolygon(const Array<Point<float>>& points, const Color& color,
+                                 Rasterizer::FillRule rule) {
+    Polygon polygon(*this, color, points, rule);
+    return polygon.fill();
+}
+
+Canvas& Canvas::addFilledPolygon(const Array<Point<float>>& points, const LinearGradient& gradient,
+                                 LinearGradient::Type type, Rasterizer::FillRule rule) {
+    Polygon polygon(*this, Color(Color::Rgb(255, 255, 255)), points, rule);
+    return polygon.fill(gradient, type);
+}
+
+Canvas& Canvas::addPath(const Path& path, const Color& color, const Stroke& stroke) {
+    Figure figure(*this, color, path);
+    return figure.draw(stroke);
+}
+
+Canvas& Canvas::addFilledPath(const Path& path, const Color& color, Rasterizer::FillRule rule) {
+    Figure figure(*this, color, path);
+    return figure.fill(rule);
+}
+
+Canvas& Canvas::addFilledPath(const Path& path, const LinearGradient& gradient,
+                              LinearGradient::Type type, Rasterizer::FillRule rule) {
+    Figure figure(*this, Color(Color::Rgb(255, 255, 255)), path);
+    return figure.fill(gradient, type, rule);
+}
+
+Canvas& Canvas::addText(Point<float> position, const std::string& text, const Color& color,
+                        const Font& font, size_t scale) {
+    // The label is drawn before returning, so it can borrow the caller's font.
+    Text label(*this, color, position, text, std::shared_ptr<const Font>(std::shared_ptr<const Font>(), &font), scale);
+    return label.draw();
+}
\ No newline at end of file
@@ -1,27 +1,101 @@
 #pragma once
 #include "Pixels.h"
 #include "Bitmap.h"
+#include "Font.h"
 #include "Point.h"
 #include "LinearGradient.h"
+#include "Path.h"
+#include "Rasterizer.h"
+#include "Stats.h"
+#include "Stroke.h"
+#include "Transform2D.h"
+#include "Array.h"
+#include <memory>
+#include <utility>
+#include <vector>
 
 namespace sglib {
+    // A Canvas is not safe to use from several threads at once. To draw from several threads,
+    // give each thread its own layer(), then merge() the layers back from one thread: layers
+    // share nothing, so drawing into them needs no locks, and merging them in a fixed order
+    // gives the same image however the threads were scheduled.
     class Canvas {
     public:
-        Canvas(size_t x, size_t y, const Color& fill = Color::white) : pixels(x, y, fill) { }
+        // Summary of the per-pixel write counts; `average` and `repeated` (a percentage) are
+        // taken over the pixels written at least once.
+        class Overdraw {
+        public:
+            uint64_t writes;
+            size_t pixels;
+            double average;
+            uint32_t maximum;
+            double repeated;
+        };
+
+        // Throws BudgetExceeded when the whole canvas would not fit in the process budget or in
+        // `budget`, which then goes on counting the canvas's pixels, its snapshots' and layers'.
+        Canvas(size_t x, size_t y, const Color& fill = Color::white,
+               Pixels::Storage storage = Pixels::Storage::Tiled, std::shared_ptr<MemoryBudget> budget = nullptr) :
+               pixels(x, y, fill, storage, std::move(budget)) { }
+        // Draws into caller-owned memory in place; see Pixels(const PixelsView&).
+        explicit Canvas(const PixelsView& view) : pixels(view) { }
         Canvas(const Canvas& other) = delete;
         Canvas& operator=(const Canvas& other) = delete;
+        Canvas(Canvas&& other) = default;
+        Canvas& operator=(Canvas&& other) = default;
+        Canvas snapshot() const;
+        // A transparent canvas of the same size, clip and antialiasing to draw into on its own
+        // thread. Only the tiles it draws into are allocated.
+        Canvas layer() const;
+        // Composites `layers` over this canvas, one after another in the
+        // order given, so overlapping layers always stack the same way. Row bands merge in
+        // parallel on the Executor; the layers must not be drawn into meanwhile. Layers keep
+        // their contents, so merging one twice composites it twice.
+        Canvas& merge(const Canvas& layer);
+        Canvas& merge(const std::vector<Canvas>& layers);
         void draw(const std::string& out, Bitmap::Type type = Bitmap::Type::bit24);
+        // Encodes the bitmap into a stream, e.g. a std::ostringstream, instead of a file.
+        void draw(std::ostream& out, Bitmap::Type type = Bitmap::Type::bit24);
+        // Rewrites only the rows changed since the last draw/redraw into a file written by draw().
+        void redraw(const std::string& out, Bitmap::Type type = Bitmap::Type::bit24);
         Canvas& fill(const Color& color = Color::white);
+        // Like fill(color), but a contiguous canvas is overwritten in place instead of being
+        // released and reallocated on the next write, for canvases reused from frame to frame.
+        Canvas& clear(const Color& color = Color::white);
         Canvas& fill(const LinearGradient& gradient, LinearGradient::Type type =
                 LinearGradient::Type::LeftToRight);
+        // Fills the 4-connected region around `seed` whose pixels differ from the seed pixel by at
+        // most `tolerance` in every channel. Stays inside the clip. Scratch memory is bounded by a
+        // fixed stack of runs plus, only for regions that overflow it, one bit per canvas pixel.
+        Canvas& floodFill(Point<float> seed, const Color& color, uint8_t tolerance = 0);
         Pixels& get();
         const Pixels& get() const;
         size_t width() const;
         size_t height() const;
+        // Smooths edges with their exact pixel coverage instead of all-or-nothing pixel centers.
+        Canvas& setAntialiasing(bool enabled);
+        bool antialiasing() const;
+        // Restricts drawing to [lowerBound, upperBound) within the current clip until the matching popClip().
+        Canvas& pushClip(Point<float> lowerBound, Point<float> upperBound);
+        Canvas& popClip();
+        // Per-primitive and encode/decode counters since construction or the last reset();
+        // zero unless the library is built with SGLIB_STATS. Snapshots start from zero.
+        RenderStats& stats();
+        const RenderStats& stats() const;
+        // Diagnostic mode counting how often every pixel is written, from zero when enabled.
+        Canvas& setOverdrawTracking(bool enabled);
+        bool overdrawTracking() const;
+        Overdraw overdraw() const;
+        // The write counts in false colour: black for none, then blue, green, yellow and red
+        // for one to four writes, fading to white at eight and more.
+        Canvas heatmap() const;
 
-        Canvas& addLine(Point<float> start, Point<float> finish, const Color& color);
-        Canvas& addEllipse(Point<float> lowerBound, Point<float> upperBound, const Color& color);
-        Canvas& addRectangle(Point<float> lowerBound, Point<float> upperBound, const Color& color);
+        Canvas& addLine(Point<float> start, Point<float> finish, const Color& color,
+                        const Stroke& stroke = Stroke());
+        Canvas& addEllipse(Point<float> lowerBound, Point<float> upperBound, const Color& color,
+                           const Stroke& stroke = Stroke());
+        Canvas& addRectangle(Point<float> lowerBound, Point<float> upperBound, const Color& color,
+                             const Stroke& stroke = Stroke());
 
         Canvas& addFilledEllipse(Point<float> lowerBound, Point<float> upperBound, const Color& color);
         Canvas& addFilledEllipse(Point<float> lowerBound, Point<float> upperBound,
@@ -31,7 +105,54 @@ namespace sglib {
         Canvas& addFilledRectangle(Point<float> lowerBound, Point<float> upperBound,
                                    const LinearGradient& gradient,
                                    LinearGradient::Type type = LinearGradient::Type::LeftToRight);
+        // The transform acts on the shape's own coordinates, e.g. Transform2D::rotate(30, center).
+        Canvas& addFilledEllipse(Point<float> lowerBound, Point<float> upperBound, const Color& color,
+                                 const Transform2D& transform);
+        Canvas& addFilledEllipse(Point<float> lowerBound, Point<float> upperBound,
+                                 const LinearGradient& gradient, LinearGradient::Type type,
+                                 const Transform2D& transform);
+        Canvas& addFilledRectangle(Point<float> lowerBound, Point<float> upperBound, const Color& color,
+                                   const Transform2D& transform);
+        Canvas& addFilledRectangle(Point<float> lowerBound, Point<float> upperBound,
+                                   const LinearGradient& gradient, LinearGradient::Type type,
+                                   const Transform2D& transform);
+
+        Canvas& addPolygon(const Array<Point<float>>& points, const Color& color,
+                           const Stroke& stroke = Stroke());
+        Canvas& addFilledPolygon(const Array<Point<float>>& points, const Color& color,
+                                 Rasterizer::FillRule rule = Rasterizer::FillRule::NonZero);
+        Canvas& addFilledPolygon(const Array<Point<float>>& points, const LinearGradient& gradient,
+                                 LinearGradient::Type type = LinearGradient::Type::LeftToRight,
+                                 Rasterizer::FillRule rule = Rasterizer::FillRule::NonZero);
+
+        Canvas& addPath(const Path& path, const Color& color, const Stroke& stroke = Stroke());
+        Canvas& addFilledPath(const Path& path, const Color& color,
+                              Rasterizer::FillRule rule = Rasterizer::FillRule::NonZero);
+        Canvas& addFilledPath(const Path& path, const LinearGradient& gradient,
+                              LinearGradient::Type type = LinearGradient::Type::LeftToRight,
+                              Rasterizer::FillRule rule = Rasterizer::FillRule::NonZero);
+
+        // `position` is the lower left corner of the first line; glyphs are magnified by `scale`.
+        Canvas& addText(Point<float> position, const std::string& text, const Color& color,
+                        const Font& font = Font::standard(), size_t scale = 1);
     private:
         Pixels pixels;
+        bool antialiased = false;
+        std::vector<std::pair<Point<size_t>, Point<size_t>>> clips;
+        RenderStats statistics;
+        // Kept between flood fills so repeated fills do not reallocate.
+        class Run {
+        public:
+            size_t y, x0, x1;
+        };
+        static constexpr size_t floodCapacity = 1 << 14;
+        std::vector<Run> floodRuns;
+        std::vector<uint64_t> floodVisited;
+        std::vector<uint64_t> floodPending;
+
+        Canvas(Pixels&& other, bool antialiased, const std::vector<std::pair<Point<size_t>, Point<size_t>>>& clips) :
+                pixels(std::move(other)), antialiased(antialiased), clips(clips) { }
+        Canvas& merge(const Canvas* const* layers, size_t count);
+        static std::unique_ptr<Bitmap> createBitmap(const std::string& out, Bitmap::Type type);
     };
 }
\ No newline at end of file
@@ -7,8 +7,10 @@ namespace sglib {
     public:
         class Rgb {
         public:
-            uint8_t red, green, blue;
-            Rgb(uint8_t r, uint8_t g, uint8_t b) : red(r), green(g), blue(b) { }
+            // Stored in BMP byte order, so rows of Rgb/Color can be written without reordering.
+            uint8_t blue, green, red;
+            Rgb() : blue(0), green(0), red(0) { }
+            Rgb(uint8_t r, uint8_t g, uint8_t b) : blue(b), green(g), red(r) { }
         };
 
         class Hsl {
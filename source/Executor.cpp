@@ -0,0 +1,156 @@
+#include "Executor.h"
+#include <algorithm>
+#include <exception>
+
+using namespace sglib;
+
+namespace {
+    std::mutex installed;
+    std::shared_ptr<Executor> current;
+    // Set while a thread runs a band, so that nested loops run inline instead of waiting on
+    // pool threads that may all be busy waiting themselves.
+    thread_local bool banded = false;
+}
+
+std::shared_ptr<Executor> Executor::get() {
+    std::lock_guard<std::mutex> lock(installed);
+    if (current == nullptr) {
+        current = std::make_shared<ThreadPool>();
+    }
+    return current;
+}
+
+void Executor::set(std::shared_ptr<Executor> executor) {
+    std::lock_guard<std::mutex> lock(installed);
+    current = std::move(executor);
+}
+
+void Executor::parallelFor(size_t begin, size_t end, size_t cost,
+                           const std::function<void(size_t, size_t)>& function, size_t grain, size_t limit) {
+    if (begin >= end) {
+        return;
+    }
+    if (cost < parallelThreshold || end - begin <= grain || banded) {
+        function(begin, end);
+        return;
+    }
+    const std::shared_ptr<Executor> executor = get();
+    size_t bands = std::min(executor->concurrency(), (end - begin + grain - 1) / grain);
+    if (limit != 0) {
+        bands = std::min(bands, limit);
+    }
+    if (bands <= 1) {
+        function(begin, end);
+        return;
+    }
+    // Rounded up to the grain, so every border but the last is a multiple of it.
+    const size_t band = ((end - begin + bands - 1) / bands + grain - 1) / grain * grain;
+    auto border = [&](size_t index) {
+        return std::min(end, index == 0 ? begin : (begin / grain * grain) + index * band);
+    };
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t remaining = 0;
+    std::exception_ptr failure;
+    auto run = [&](size_t first, size_t last) {
+        const bool nested = banded;
+        banded = true;
+        try {
+            function(first, last);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (failure == nullptr) {
+                failure = std::current_exception();
+            }
+        }
+        banded = nested;
+    };
+    bool refused = false;
+    for (size_t index = 1; border(index) < end; index++) {
+        const size_t first = border(index);
+        const size_t last = border(index + 1);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            remaining++;
+        }
+        try {
+            executor->submit([&, first, last] {
+                run(first, last);
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--remaining == 0) {
+                    finished.notify_one();
+                }
+            });
+        } catch (...) {
+            // The bands already submitted use this frame, so they must finish before it throws.
+            std::lock_guard<std::mutex> lock(mutex);
+            remaining--;
+            if (failure == nullptr) {
+                failure = std::current_exception();
+            }
+            refused = true;
+            break;
+        }
+    }
+    if (!refused) {
+        run(begin, border(1));
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return remaining == 0; });
+    if (failure != nullptr) {
+        std::rethrow_exception(failure);
+    }
+}
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 1; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    if (workers.empty()) {
+        task();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    available.notify_one();
+}
+
+size_t ThreadPool::concurrency() const {
+    return workers.size() + 1;
+}
+
+void ThreadPool::work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
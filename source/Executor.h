@@ -0,0 +1,60 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sglib {
+    // Runs the row bands of whole-image operations. The library uses a ThreadPool sized to the
+    // hardware by default; a host application can route the work to its own pool by installing
+    // an Executor whose submit() hands tasks over to it.
+    class Executor {
+    public:
+        // Work below this many pixel operations runs on the calling thread without touching the executor.
+        const static size_t parallelThreshold = 1 << 18;
+
+        virtual ~Executor() = default;
+        // Runs `task` eventually, on any thread. Tasks must not wait for one another.
+        virtual void submit(std::function<void()> task) = 0;
+        // How many bands to split work into, counting the calling thread, which runs one of them.
+        virtual size_t concurrency() const = 0;
+
+        static std::shared_ptr<Executor> get();
+        // nullptr restores the built-in pool.
+        static void set(std::shared_ptr<Executor> executor);
+        // Calls function(first, last) on disjoint bands covering [begin, end) and returns once all
+        // of them are done, rethrowing the first exception thrown by any of them. If submit()
+        // throws, no further band starts and its exception is rethrown once the submitted ones
+        // finish. Band borders are multiples of `grain`; `limit`, when not 0, caps the number of bands.
+        static void parallelFor(size_t begin, size_t end, size_t cost,
+                                const std::function<void(size_t, size_t)>& function,
+                                size_t grain = 1, size_t limit = 0);
+    };
+
+    class ThreadPool : public Executor {
+    public:
+        // 0 threads means one per hardware thread. The calling thread counts as one of them,
+        // so a pool of 1 starts no threads and runs every task inline.
+        explicit ThreadPool(size_t threads = 0);
+        ThreadPool(const ThreadPool& other) = delete;
+        ThreadPool& operator=(const ThreadPool& other) = delete;
+        // Finishes the queued tasks before joining the workers.
+        ~ThreadPool() override;
+
+        void submit(std::function<void()> task) override;
+        size_t concurrency() const override;
+
+    private:
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable available;
+        bool stopping = false;
+
+        void work();
+    };
+}
@@ -0,0 +1,173 @@
+#include "Font.h"
+#include "Bitmap.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace sglib;
+
+namespace {
+    const size_t missing = static_cast<size_t>(-1);
+
+    // Column-major, least significant bit at the top, for ' ' through '~'.
+    const uint8_t standardGlyphs[95][5] = {
+        {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00},
+        {0x14, 0x7F, 0x14, 0x7F, 0x14}, {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},
+        {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00}, {0x00, 0x1C, 0x22, 0x41, 0x00},
+        {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x08, 0x2A, 0x1C, 0x2A, 0x08}, {0x08, 0x08, 0x3E, 0x08, 0x08},
+        {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x60, 0x60, 0x00, 0x00},
+        {0x20, 0x10, 0x08, 0x04, 0x02}, {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00},
+        {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31}, {0x18, 0x14, 0x12, 0x7F, 0x10},
+        {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},
+        {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x36, 0x36, 0x00, 0x00},
+        {0x00, 0x56, 0x36, 0x00, 0x00}, {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14},
+        {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06}, {0x32, 0x49, 0x79, 0x41, 0x3E},
+        {0x7E, 0x11, 0x11, 0x11, 0x7E}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},
+        {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x01, 0x01},
+        {0x3E, 0x41, 0x41, 0x51, 0x32}, {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00},
+        {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, {0x7F, 0x40, 0x40, 0x40, 0x40},
+        {0x7F, 0x02, 0x04, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},
+        {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46},
+        {0x46, 0x49, 0x49, 0x49, 0x31}, {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F},
+        {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x7F, 0x20, 0x18, 0x20, 0x7F}, {0x63, 0x14, 0x08, 0x14, 0x63},
+        {0x03, 0x04, 0x78, 0x04, 0x03}, {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00},
+        {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00}, {0x04, 0x02, 0x01, 0x02, 0x04},
+        {0x40, 0x40, 0x40, 0x40, 0x40}, {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78},
+        {0x7F, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20}, {0x38, 0x44, 0x44, 0x48, 0x7F},
+        {0x38, 0x54, 0x54, 0x54, 0x18}, {0x08, 0x7E, 0x09, 0x01, 0x02}, {0x0C, 0x52, 0x52, 0x52, 0x3E},
+        {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, {0x20, 0x40, 0x44, 0x3D, 0x00},
+        {0x7F, 0x10, 0x28, 0x44, 0x00}, {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x18, 0x04, 0x78},
+        {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38}, {0x7C, 0x14, 0x14, 0x14, 0x08},
+        {0x08, 0x14, 0x14, 0x18, 0x7C}, {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x20},
+        {0x04, 0x3F, 0x44, 0x40, 0x20}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, {0x1C, 0x20, 0x40, 0x20, 0x1C},
+        {0x3C, 0x40, 0x30, 0x40, 0x3C}, {0x44, 0x28, 0x10, 0x28, 0x44}, {0x0C, 0x50, 0x50, 0x50, 0x3C},
+        {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00}, {0x00, 0x00, 0x7F, 0x00, 0x00},
+        {0x00, 0x41, 0x36, 0x08, 0x00}, {0x08, 0x04, 0x08, 0x10, 0x08}
+    };
+
+    std::vector<uint8_t> standardMasks() {
+        std::vector<uint8_t> masks(95 * 5 * 7, 0);
+        for (size_t glyph = 0; glyph < 95; glyph++) {
+            uint8_t* mask = masks.data() + glyph * 5 * 7;
+            for (size_t x = 0; x < 5; x++) {
+                for (size_t row = 0; row < 7; row++) {
+                    if ((standardGlyphs[glyph][x] >> row) & 1) {
+                        mask[(6 - row) * 5 + x] = 255;
+                    }
+                }
+            }
+        }
+        return masks;
+    }
+}
+
+Font::Font(size_t glyphWidth, size_t glyphHeight, unsigned char first, std::vector<uint8_t>&& masks) :
+        width_(glyphWidth), height_(glyphHeight), masks_(std::move(masks)) {
+    if (width_ == 0 || height_ == 0 || width_ > UINT16_MAX || height_ > UINT16_MAX) {
+        throw std::invalid_argument("unsupported glyph size");
+    }
+    const size_t count = std::min(masks_.size() / (width_ * height_), static_cast<size_t>(256 - first));
+    slots_.fill(missing);
+    runOffsets_.push_back(0);
+    for (size_t glyph = 0; glyph < count; glyph++) {
+        const uint8_t* mask = masks_.data() + glyph * width_ * height_;
+        for (size_t y = 0; y < height_; y++) {
+            const uint8_t* line = mask + y * width_;
+            size_t x = 0;
+            while (x < width_) {
+                const size_t start = x;
+                while (x < width_ && line[x] == line[start]) {
+                    x++;
+                }
+                if (line[start] != 0) {
+                    runs_.push_back({static_cast<uint16_t>(y), static_cast<uint16_t>(start),
+                                     static_cast<uint16_t>(x), line[start]});
+                }
+            }
+        }
+        runOffsets_.push_back(runs_.size());
+        slots_[first + glyph] = glyph;
+    }
+    const size_t fallback = slots_[static_cast<unsigned char>('?')];
+    for (auto& slot : slots_) {
+        if (slot == missing) {
+            slot = fallback;
+        }
+    }
+}
+
+const Font& Font::standard() {
+    static const Font font(5, 7, ' ', standardMasks());
+    return font;
+}
+
+Font Font::load(const std::string& path, size_t glyphWidth, size_t glyphHeight, char first) {
+    Bitmap24 bitmap(path);
+    bitmap.read();
+    const Pixels& pixels = bitmap.getPixels();
+    if (glyphWidth == 0 || glyphHeight == 0 || glyphWidth > pixels.width() || glyphHeight > pixels.height()) {
+        throw std::invalid_argument("glyph size does not fit the font atlas");
+    }
+    const size_t columns = pixels.width() / glyphWidth;
+    const size_t rows = pixels.height() / glyphHeight;
+    std::vector<uint8_t> masks(columns * rows * glyphWidth * glyphHeight);
+    for (size_t cell = 0; cell < columns * rows; cell++) {
+        const size_t left = (cell % columns) * glyphWidth;
+        // Image rows are stored bottom-up, so the first row of cells is at the end.
+        const size_t bottom = pixels.height() - (cell / columns + 1) * glyphHeight;
+        uint8_t* mask = masks.data() + cell * glyphWidth * glyphHeight;
+        for (size_t y = 0; y < glyphHeight; y++) {
+            const Color* line = pixels.row(bottom + y) + left;
+            for (size_t x = 0; x < glyphWidth; x++) {
+                mask[y * glyphWidth + x] = static_cast<uint8_t>(255 - Gray8::fromColor(line[x]));
+            }
+        }
+    }
+    return Font(glyphWidth, glyphHeight, static_cast<unsigned char>(first), std::move(masks));
+}
+
+size_t Font::glyphWidth() const {
+    return width_;
+}
+
+size_t Font::glyphHeight() const {
+    return height_;
+}
+
+size_t Font::advance() const {
+    return width_ + 1;
+}
+
+size_t Font::lineHeight() const {
+    return height_ + 1;
+}
+
+Point<float> Font::measure(const std::string& text, size_t scale) const {
+    size_t longest = 0;
+    size_t current = 0;
+    size_t lines = 1;
+    for (char character : text) {
+        if (character == '\n') {
+            lines++;
+            current = 0;
+            continue;
+        }
+        current++;
+        longest = std::max(longest, current);
+    }
+    const size_t width = longest == 0 ? 0 : longest * advance() - 1;
+    const size_t height = lines * lineHeight() - 1;
+    return {static_cast<float>(width * scale), static_cast<float>(height * scale)};
+}
+
+std::pair<const Font::Run*, const Font::Run*> Font::runs(char character) const {
+    const size_t slot = slots_[static_cast<unsigned char>(character)];
+    if (slot == missing) {
+        return {nullptr, nullptr};
+    }
+    return {runs_.data() + runOffsets_[slot], runs_.data() + runOffsets_[slot + 1]};
+}
+
+const uint8_t* Font::mask(char character) const {
+    const size_t slot = slots_[static_cast<unsigned char>(character)];
+    return slot == missing ? nullptr : masks_.data() + slot * width_ * height_;
+}
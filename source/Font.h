@@ -0,0 +1,45 @@
+#pragma once
+#include "Point.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sglib {
+    class Font {
+    public:
+        // A horizontal piece of a glyph with constant coverage, in glyph pixels from the lower left.
+        class Run {
+        public:
+            uint16_t y, x0, x1;
+            uint8_t coverage;
+        };
+
+        // 5x7 pixel font embedded in the library, covering printable ASCII.
+        static const Font& standard();
+        // Reads a 24-bit BMP holding a grid of glyphWidth x glyphHeight cells, left to right and top
+        // to bottom, starting at character `first`. Dark pixels are ink, light ones background.
+        static Font load(const std::string& path, size_t glyphWidth, size_t glyphHeight, char first = ' ');
+
+        size_t glyphWidth() const;
+        size_t glyphHeight() const;
+        size_t advance() const;
+        size_t lineHeight() const;
+        Point<float> measure(const std::string& text, size_t scale = 1) const;
+        // Characters the font lacks are drawn as '?', or left blank if that is missing too.
+        std::pair<const Run*, const Run*> runs(char character) const;
+        // glyphWidth x glyphHeight coverage values, bottom row first.
+        const uint8_t* mask(char character) const;
+
+    private:
+        Font(size_t glyphWidth, size_t glyphHeight, unsigned char first, std::vector<uint8_t>&& masks);
+
+        size_t width_, height_;
+        // All glyph masks and their runs are built once, so drawing is a table lookup per character.
+        std::vector<uint8_t> masks_;
+        std::vector<Run> runs_;
+        std::vector<size_t> runOffsets_;
+        std::array<size_t, 256> slots_;
+    };
+}
@@ -1,46 +1,69 @@
 #include "LinearGradient.h"
+#include "Allocator.h"
 #include "stdexcept"
+#include <algorithm>
 #include <cmath>
 
 using namespace sglib;
 
 void LinearGradient::set(size_t index, const Color& color) {
-    colors_[index] = color;
+    own()[index] = color;
 }
 
 Color& LinearGradient::get(size_t index) {
-    return colors_[index];
+    return own()[index];
 }
 
 const Color& LinearGradient::get(size_t index) const {
-    return colors_[index];
+    return (*colors_)[index];
 }
 
 void LinearGradient::apply(Pixels& pixels,
                            const Point<float>& lowerBound,
                            const Point<float>& upperBound,
-                           const std::function<bool(size_t, size_t)>& function,
+                           const std::function<std::pair<int64_t, int64_t>(int64_t)>& span,
                            Type type) const {
-
-    float length = upperBound.x() - lowerBound.x();
-
-    const Point<size_t> lowerBoundSizeT = {static_cast<size_t>(lowerBound.x()),
-                                  static_cast<size_t>(lowerBound.y())};
-    const Point<size_t> upperBoundSizeT = {static_cast<size_t>(upperBound.x()),
-                                           static_cast<size_t>(upperBound.y())};
-
-    if (type == Type::UpToBottom || type == Type::BottomToUp) {
-        length = upperBound.y() - lowerBound.y();
-    } else if(type != Type::LeftToRight && type != Type::RightToLeft) {
+    const bool horizontal = type == Type::LeftToRight || type == Type::RightToLeft;
+    if (!horizontal && type != Type::UpToBottom && type != Type::BottomToUp) {
         throw std::invalid_argument("unsupported gradient type");
     }
-    auto lengthSizeT = static_cast<size_t>(length);
-    const float difference = length / static_cast<float>(colors_.size() - 1);
-    const auto repeats = static_cast<size_t>(difference);
+    if (colors_->size() < 2) {
+        return;
+    }
+    const float length = horizontal ? upperBound.x() - lowerBound.x() : upperBound.y() - lowerBound.y();
+    const auto lengthInt = static_cast<int64_t>(length);
+    const float difference = length / static_cast<float>(colors_->size() - 1);
+    const auto repeats = static_cast<int64_t>(difference);
+    const auto stripes = repeats * static_cast<int64_t>(colors_->size() - 1);
+    // Stripe k lies k pixels from the start of the box, or from its end when the gradient runs
+    // right to left or up to bottom; pixels past the last stripe are left alone.
+    const bool reversed = type == Type::RightToLeft || type == Type::UpToBottom;
+    const int64_t alongFirst = reversed ? lengthInt - stripes : 0;
+    const int64_t alongLast = reversed ? lengthInt : stripes;
+    const auto across = static_cast<int64_t>(ceilf(horizontal ? upperBound.y() - lowerBound.y() :
+                                                                upperBound.x() - lowerBound.x()));
+
+    const auto left = static_cast<int64_t>(lowerBound.x());
+    const auto top = static_cast<int64_t>(lowerBound.y());
+    Point<size_t> clipLower, clipUpper;
+    pixels.getClip(clipLower, clipUpper);
+    const int64_t firstRow = std::max(horizontal ? 0 : alongFirst, static_cast<int64_t>(clipLower.y()) - top);
+    const int64_t lastRow = std::min(horizontal ? across : alongLast, static_cast<int64_t>(clipUpper.y()) - top);
+    const int64_t firstColumn = std::max(horizontal ? alongFirst : 0, static_cast<int64_t>(clipLower.x()) - left);
+    const int64_t lastColumn = std::min(horizontal ? alongLast : across, static_cast<int64_t>(clipUpper.x()) - left);
+    if (firstRow >= lastRow || firstColumn >= lastColumn) {
+        return;
+    }
 
-    for (size_t i = 0; i + 1 < colors_.size(); i++) {
-        Color start = colors_[i];
-        Color finish = colors_[i + 1];
+    // Colors of the stripes that can be seen, stepped from one to the next as they always were.
+    const int64_t first = horizontal ? firstColumn : firstRow;
+    const int64_t last = horizontal ? lastColumn : lastRow;
+    Arena::Scope scratch;
+    Color* visible = Arena::local().allocate<Color>(static_cast<size_t>(last - first));
+    int64_t stripe = 0;
+    for (size_t i = 0; i + 1 < colors_->size(); i++) {
+        Color start = (*colors_)[i];
+        Color finish = (*colors_)[i + 1];
         const float rStep = static_cast<float>(std::abs(finish.r() -
                 static_cast<int>(start.r()))) / difference;
         const float gStep = static_cast<float>(std::abs(finish.g() -
@@ -50,27 +73,12 @@ void LinearGradient::apply(Pixels& pixels,
         float r = start.r();
         float g = start.g();
         float b = start.b();
-        for(size_t j = 0; j < repeats; j++) {
-            Color next(Color::Rgb{static_cast<uint8_t>(roundf(r)),
-                                  static_cast<uint8_t>(roundf(g)),
-                                  static_cast<uint8_t>(roundf(b))});
-
-            if (type == Type::LeftToRight) {
-                pixels.setRangeIf({i * repeats + j, 0},
-                                  {i * repeats + j + 1, upperBoundSizeT.y()},
-                                  function, next, lowerBoundSizeT);
-            } else if (type == Type::RightToLeft) {
-                pixels.setRangeIf({lengthSizeT - i * repeats - j - 1, 0},
-                                {lengthSizeT - i * repeats - j, upperBoundSizeT.y()},
-                                function, next, lowerBoundSizeT);
-            } else if (type == Type::UpToBottom) {
-                pixels.setRangeIf({0, lengthSizeT - i * repeats - j - 1},
-                                {upperBoundSizeT.x(), lengthSizeT - i * repeats - j},
-                                function, next, lowerBoundSizeT);
-            } else {
-                pixels.setRangeIf({0, i * repeats + j},
-                                {upperBoundSizeT.x(), i * repeats + j + 1},
-                                function, next, lowerBoundSizeT);
+        for (int64_t j = 0; j < repeats; j++, stripe++) {
+            const int64_t position = reversed ? lengthInt - stripe - 1 : stripe;
+            if (position >= first && position < last) {
+                visible[position - first] = Color(Color::Rgb{static_cast<uint8_t>(roundf(r)),
+                                                             static_cast<uint8_t>(roundf(g)),
+                                                             static_cast<uint8_t>(roundf(b))});
             }
 
             if (start.r() < finish.r()) {
@@ -92,12 +100,70 @@ void LinearGradient::apply(Pixels& pixels,
             }
         }
     }
+
+    auto rows = [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+            const int64_t row = static_cast<int64_t>(y) - top;
+            const auto columns = span(row);
+            const int64_t x0 = std::max(columns.first, firstColumn);
+            const int64_t x1 = std::min(columns.second, lastColumn);
+            if (x0 >= x1) {
+                continue;
+            }
+            if (horizontal) {
+                pixels.copySpan(static_cast<int64_t>(y), x0 + left, x1 + left, visible + (x0 - first));
+            } else {
+                pixels.setSpan(static_cast<int64_t>(y), x0 + left, x1 + left, visible[row - first]);
+            }
+        }
+    };
+    const auto cost = static_cast<size_t>((lastRow - firstRow) * (lastColumn - firstColumn));
+    pixels.parallelRows(static_cast<size_t>(firstRow + top), static_cast<size_t>(lastRow + top), cost, std::ref(rows));
+}
+
+Array<Color> LinearGradient::ramp(size_t length) const {
+    Array<Color> result(length);
+    if (length > 0) {
+        ramp(&result[0], length);
+    }
+    return result;
 }
 
-LinearGradient::LinearGradient(std::initializer_list<Color> colors) : colors_(colors.size()) {
+void LinearGradient::ramp(Color* result, size_t length) const {
+    std::fill_n(result, length, (*colors_)[colors_->size() - 1]);
+    if (colors_->size() < 2) {
+        return;
+    }
+    const float difference = static_cast<float>(length) / static_cast<float>(colors_->size() - 1);
+    const auto repeats = static_cast<size_t>(difference);
+
+    for (size_t i = 0; i + 1 < colors_->size(); i++) {
+        const Color& start = (*colors_)[i];
+        const Color& finish = (*colors_)[i + 1];
+        const float rStep = static_cast<float>(finish.r() - static_cast<int>(start.r())) / difference;
+        const float gStep = static_cast<float>(finish.g() - static_cast<int>(start.g())) / difference;
+        const float bStep = static_cast<float>(finish.b() - static_cast<int>(start.b())) / difference;
+        for (size_t j = 0; j < repeats; j++) {
+            const auto step = static_cast<float>(j);
+            result[i * repeats + j] = Color(Color::Rgb{static_cast<uint8_t>(roundf(start.r() + rStep * step)),
+                                                       static_cast<uint8_t>(roundf(start.g() + gStep * step)),
+                                                       static_cast<uint8_t>(roundf(start.b() + bStep * step))});
+        }
+    }
+}
+
+LinearGradient::LinearGradient(std::initializer_list<Color> colors) :
+        colors_(std::make_shared<Array<Color>>(colors.size())) {
     size_t index = 0;
     for(const auto& i : colors) {
-        colors_[index] = i;
+        (*colors_)[index] = i;
         index++;
     }
+}
+
+Array<Color>& LinearGradient::own() {
+    if (colors_.use_count() > 1) {
+        colors_ = std::make_shared<Array<Color>>(*colors_);
+    }
+    return *colors_;
 }
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include "Pixels.h"
 #include "Point.h"
 #include "functional"
+#include <cstdint>
+#include <memory>
+#include <utility>
 
 namespace sglib {
     class LinearGradient {
@@ -14,18 +17,28 @@ namespace sglib {
             UpToBottom,
             BottomToUp
         };
-        explicit LinearGradient(const Array<Color>& colors) : colors_(colors) { }
+        explicit LinearGradient(const Array<Color>& colors) : colors_(std::make_shared<Array<Color>>(colors)) { }
+        explicit LinearGradient(Array<Color>&& colors) :
+                colors_(std::make_shared<Array<Color>>(std::move(colors))) { }
         LinearGradient(std::initializer_list<Color> colors);
 
+        // Paints the columns span(j), a half-open range, of each row j of the box, both counted
+        // from lowerBound, one span per row and only within the clip.
         void apply(Pixels& pixels, const Point<float>& lowerBound,
                    const Point<float>& upperBound,
-                   const std::function<bool(size_t, size_t)>& function, Type type) const;
+                   const std::function<std::pair<int64_t, int64_t>(int64_t)>& span, Type type) const;
+        Array<Color> ramp(size_t length) const;
+        // The same colors written to `result`, which holds `length` of them.
+        void ramp(Color* result, size_t length) const;
 
         void set(size_t index, const Color& color);
         Color& get(size_t index);
         const Color& get(size_t index) const;
 
     private:
-        Array<Color> colors_;
+        // Shared between copies until one of them is changed.
+        std::shared_ptr<Array<Color>> colors_;
+
+        Array<Color>& own();
     };
 }
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "Path.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace sglib;
+
+namespace {
+    const size_t maximalDepth = 16;
+
+    Point<float> middle(const Point<float>& a, const Point<float>& b) {
+        return {(a.x() + b.x()) / 2.0f, (a.y() + b.y()) / 2.0f};
+    }
+
+    float deviation(const Point<float>& start, const Point<float>& finish, const Point<float>& point) {
+        const float dx = finish.x() - start.x();
+        const float dy = finish.y() - start.y();
+        const float length = sqrtf(dx * dx + dy * dy);
+        if (length < 1e-6f) {
+            return sqrtf((point.x() - start.x()) * (point.x() - start.x()) +
+                         (point.y() - start.y()) * (point.y() - start.y()));
+        }
+        return std::abs((point.x() - start.x()) * dy - (point.y() - start.y()) * dx) / length;
+    }
+}
+
+Path& Path::moveTo(const Point<float>& point) {
+    verbs.push_back(Verb::Move);
+    points.push_back(point);
+    invalidate();
+    return *this;
+}
+
+Path& Path::lineTo(const Point<float>& point) {
+    verbs.push_back(Verb::Line);
+    points.push_back(point);
+    invalidate();
+    return *this;
+}
+
+Path& Path::quadTo(const Point<float>& control, const Point<float>& point) {
+    verbs.push_back(Verb::Quad);
+    points.push_back(control);
+    points.push_back(point);
+    invalidate();
+    return *this;
+}
+
+Path& Path::cubicTo(const Point<float>& first, const Point<float>& second, const Point<float>& point) {
+    verbs.push_back(Verb::Cubic);
+    points.push_back(first);
+    points.push_back(second);
+    points.push_back(point);
+    invalidate();
+    return *this;
+}
+
+Path& Path::close() {
+    verbs.push_back(Verb::Close);
+    invalidate();
+    return *this;
+}
+
+Path& Path::transform(const Transform2D& transform) {
+    transform.apply(points.data(), points.size());
+    invalidate();
+    return *this;
+}
+
+bool Path::empty() const {
+    return verbs.empty();
+}
+
+void Path::invalidate() {
+    flattenedTolerance = -1.0f;
+}
+
+const std::vector<Path::Contour>& Path::flatten(float tolerance) const {
+    if (tolerance == flattenedTolerance) {
+        return contours;
+    }
+    contours.clear();
+    Point<float> start;
+    size_t index = 0;
+    for (Verb verb : verbs) {
+        if (verb == Verb::Move) {
+            start = points[index++];
+            contours.emplace_back();
+            contours.back().points.push_back(start);
+            continue;
+        }
+        if (verb == Verb::Close) {
+            if (!contours.empty()) {
+                contours.back().closed = true;
+            }
+            continue;
+        }
+        if (contours.empty() || contours.back().closed) {
+            contours.emplace_back();
+            contours.back().points.push_back(start);
+        }
+        std::vector<Point<float>>& result = contours.back().points;
+        const Point<float> current = result.back();
+        if (verb == Verb::Line) {
+            result.push_back(points[index]);
+            index += 1;
+        } else if (verb == Verb::Quad) {
+            flattenQuad(current, points[index], points[index + 1], tolerance, 0, result);
+            index += 2;
+        } else {
+            flattenCubic(current, points[index], points[index + 1], points[index + 2], tolerance, 0, result);
+            index += 3;
+        }
+    }
+    flattenedTolerance = tolerance;
+    return contours;
+}
+
+bool Path::getBounds(Point<float>& lowerBound, Point<float>& upperBound, float tolerance) const {
+    bool found = false;
+    for (const auto& contour : flatten(tolerance)) {
+        for (const auto& point : contour.points) {
+            if (!found) {
+                lowerBound = point;
+                upperBound = point;
+                found = true;
+            }
+            lowerBound = {std::min(lowerBound.x(), point.x()), std::min(lowerBound.y(), point.y())};
+            upperBound = {std::max(upperBound.x(), point.x()), std::max(upperBound.y(), point.y())};
+        }
+    }
+    return found;
+}
+
+void Path::flattenQuad(const Point<float>& p0, const Point<float>& p1, const Point<float>& p2,
+                       float tolerance, size_t depth, std::vector<Point<float>>& result) {
+    if (depth >= maximalDepth || deviation(p0, p2, p1) / 2.0f <= tolerance) {
+        result.push_back(p2);
+        return;
+    }
+    const Point<float> q0 = middle(p0, p1);
+    const Point<float> q1 = middle(p1, p2);
+    const Point<float> split = middle(q0, q1);
+    flattenQuad(p0, q0, split, tolerance, depth + 1, result);
+    flattenQuad(split, q1, p2, tolerance, depth + 1, result);
+}
+
+void Path::flattenCubic(const Point<float>& p0, const Point<float>& p1, const Point<float>& p2,
+                        const Point<float>& p3, float tolerance, size_t depth,
+                        std::vector<Point<float>>& result) {
+    const float distance = std::max(deviation(p0, p3, p1), deviation(p0, p3, p2));
+    if (depth >= maximalDepth || distance * 0.75f <= tolerance) {
+        result.push_back(p3);
+        return;
+    }
+    const Point<float> q0 = middle(p0, p1);
+    const Point<float> q1 = middle(p1, p2);
+    const Point<float> q2 = middle(p2, p3);
+    const Point<float> r0 = middle(q0, q1);
+    const Point<float> r1 = middle(q1, q2);
+    const Point<float> split = middle(r0, r1);
+    flattenCubic(p0, q0, r0, split, tolerance, depth + 1, result);
+    flattenCubic(split, r1, q2, p3, tolerance, depth + 1, result);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "Point.h"
+#include "Transform2D.h"
+#include <vector>
+
+namespace sglib {
+    class Path {
+    public:
+        class Contour {
+        public:
+            std::vector<Point<float>> points;
+            bool closed = false;
+        };
+
+        Path& moveTo(const Point<float>& point);
+        Path& lineTo(const Point<float>& point);
+        Path& quadTo(const Point<float>& control, const Point<float>& point);
+        Path& cubicTo(const Point<float>& first, const Point<float>& second, const Point<float>& point);
+        Path& close();
+        // Moves every point of the path, curve control points included, in one batch.
+        Path& transform(const Transform2D& transform);
+
+        // Curves are subdivided until every piece deviates from its chord by at most `tolerance`
+        // pixels. The result is kept until the path changes or another tolerance is requested.
+        const std::vector<Contour>& flatten(float tolerance = 0.25f) const;
+        bool getBounds(Point<float>& lowerBound, Point<float>& upperBound, float tolerance = 0.25f) const;
+        bool empty() const;
+
+    private:
+        enum class Verb {
+            Move,
+            Line,
+            Quad,
+            Cubic,
+            Close
+        };
+
+        std::vector<Verb> verbs;
+        std::vector<Point<float>> points;
+        mutable std::vector<Contour> contours;
+        mutable float flattenedTolerance = -1.0f;
+
+        void invalidate();
+        static void flattenQuad(const Point<float>& p0, const Point<float>& p1, const Point<float>& p2,
+                                float tolerance, size_t depth, std::vector<Point<float>>& result);
+        static void flattenCubic(const Point<float>& p0, const Point<float>& p1, const Point<float>& p2,
+                                 const Point<float>& p3, float tolerance, size_t depth,
+                                 std::vector<Point<float>>& result);
+    };
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include "Color.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace sglib {
+    class Gray8 {
+    public:
+        using Value = uint8_t;
+        const static uint8_t bytesPerPixel = 1;
+
+        static Value fromColor(const Color& color) {
+            return static_cast<Value>((color.r() * 77 + color.g() * 150 + color.b() * 29) >> 8);
+        }
+
+        static Color toColor(Value value) {
+            return Color(Color::Rgb(value, value, value));
+        }
+
+        static void blend(Value& target, Value source, uint8_t coverage) {
+            target = static_cast<Value>((source * coverage + target * (255 - coverage) + 127) / 255);
+        }
+    };
+
+    class Rgb24 {
+    public:
+        using Value = Color::Rgb;
+        const static uint8_t bytesPerPixel = 3;
+
+        static Value fromColor(const Color& color) {
+            return color.getRgb();
+        }
+
+        static Color toColor(const Value& value) {
+            return Color(value);
+        }
+
+        static void blend(Value& target, const Value& source, uint8_t coverage) {
+            Gray8::blend(target.red, source.red, coverage);
+            Gray8::blend(target.green, source.green, coverage);
+            Gray8::blend(target.blue, source.blue, coverage);
+        }
+    };
+
+    class Rgba32 {
+    public:
+        using Value = Color;
+        const static uint8_t bytesPerPixel = 4;
+
+        static const Value& fromColor(const Color& color) {
+            return color;
+        }
+
+        static const Color& toColor(const Value& value) {
+            return value;
+        }
+
+        // Source-over compositing, with the source alpha scaled by coverage. Colors are not
+        // premultiplied, so a translucent target weighs its color by its own alpha.
+        static void blend(Value& target, const Value& source, uint8_t coverage) {
+            const auto alpha = static_cast<uint8_t>((source.a() * coverage + 127) / 255);
+            if (alpha == 255) {
+                target = source;
+                return;
+            }
+            if (target.a() == 255) {
+                Gray8::blend(target.r(), source.r(), alpha);
+                Gray8::blend(target.g(), source.g(), alpha);
+                Gray8::blend(target.b(), source.b(), alpha);
+                return;
+            }
+            const int below = (target.a() * (255 - alpha) + 127) / 255;
+            const int total = alpha + below;
+            if (total == 0) {
+                return;
+            }
+            auto mix = [alpha, below, total](uint8_t over, uint8_t under) {
+                return static_cast<uint8_t>((over * alpha + under * below + total / 2) / total);
+            };
+            target = Color(Color::Rgb(mix(source.r(), target.r()), mix(source.g(), target.g()),
+                                      mix(source.b(), target.b())), static_cast<uint8_t>(total));
+        }
+    };
+
+    static_assert(sizeof(Rgb24::Value) == Rgb24::bytesPerPixel, "Rgb24 must be tightly packed");
+    static_assert(sizeof(Rgba32::Value) == Rgba32::bytesPerPixel, "Rgba32 must be tightly packed");
+
+    template<typename Source, typename Target>
+    class FormatConverter {
+    public:
+        static void convert(const typename Source::Value* source, typename Target::Value* target, size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                target[i] = Target::fromColor(Source::toColor(source[i]));
+            }
+        }
+    };
+
+    // Color is laid out as its Rgb followed by alpha, so converting only drops every fourth byte,
+    // which compiles to a shuffle instead of a call per pixel.
+    template<>
+    class FormatConverter<Rgba32, Rgb24> {
+    public:
+        static void convert(const Rgba32::Value* source, Rgb24::Value* target, size_t count) {
+            static_assert(sizeof(Rgb24::Value) == 3, "Rgb24 must be tightly packed");
+            const auto* from = reinterpret_cast<const uint8_t*>(source);
+            auto* to = reinterpret_cast<uint8_t*>(target);
+            for (size_t i = 0; i < count; i++) {
+                to[3 * i] = from[4 * i];
+                to[3 * i + 1] = from[4 * i + 1];
+                to[3 * i + 2] = from[4 * i + 2];
+            }
+        }
+    };
+
+    template<typename Format>
+    class FormatConverter<Format, Format> {
+    public:
+        static void convert(const typename Format::Value* source, typename Format::Value* target, size_t count) {
+            std::copy_n(source, count, target);
+        }
+    };
+}
@@ -1,126 +1,568 @@
 #include "Pixels.h"
+#include "Allocator.h"
 #include <stdexcept>
 #include <string>
 #include <algorithm>
 #include <cmath>
+#include <functional>
+#include <new>
+#include <type_traits>
 
 using namespace sglib;
 
-Pixels::Pixels(size_t width, size_t height)  :
-    imageWidth(width), imageHeight(height), colors(nullptr) {
-    colors = new Color[width * height];
-    for (size_t i = 0; i < width; i++) {
-        for (size_t j = 0; j < height; j++) {
-            *(colors + i * height + j) = Color();
+template<typename Format>
+BasicPixels<Format>::BasicPixels(size_t width, size_t height, Storage storage) :
+    BasicPixels(width, height, Value(), storage) { }
+
+template<typename Format>
+BasicPixels<Format>::BasicPixels(size_t width, size_t height, const Value& value, Storage storage,
+                                 std::shared_ptr<MemoryBudget> budget) :
+    imageWidth(width), imageHeight(height), rowStride(width * sizeof(Value)), tileShift(0), storageType(storage),
+    externalMemory(false), memoryBudget(std::move(budget)), backgroundValue(value), clipLower(0, 0),
+    clipUpper(width, height), writtenPixels(0), clippedPixels(0) {
+    // Checked before anything is allocated, so that an oversized image fails here rather than
+    // on whichever write first needs a tile.
+    const uint64_t whole = footprint(width, height);
+    if (memoryBudget != nullptr) {
+        memoryBudget->require(whole);
+    }
+    MemoryBudget::process().require(whole);
+    if (storage == Storage::Tiled) {
+        while ((static_cast<size_t>(1) << tileShift) < tileRows) {
+            tileShift++;
+        }
+    } else {
+        tileShift = sizeof(size_t) * 8 - 1;
+    }
+    if (!empty()) {
+        tiles.resize(((height - 1) >> tileShift) + 1);
+        dirtyRows.resize((height + 63) / 64);
+    }
+    fill(value);
+}
+
+template<typename Format>
+BasicPixels<Format>::BasicPixels(const BasicPixelsView<Format>& view) :
+    imageWidth(view.width), imageHeight(view.height), rowStride(view.stride), tileShift(sizeof(size_t) * 8 - 1),
+    storageType(Storage::Contiguous), externalMemory(true), backgroundValue(), clipLower(0, 0),
+    clipUpper(view.width, view.height), writtenPixels(0), clippedPixels(0) {
+    if (view.stride < view.width * sizeof(Value)) {
+        throw std::invalid_argument("stride is shorter than a row");
+    }
+    if (!empty()) {
+        if (view.data == nullptr) {
+            throw std::invalid_argument("view has no memory");
         }
+        // The memory stays the caller's: the tile never frees it, and writes never copy it.
+        tiles.emplace_back(view.data, [](Value*) { });
+        dirtyRows.resize((view.height + 63) / 64);
     }
 }
 
-Pixels::Pixels(size_t width, size_t height, const Color& color) :
-    imageWidth(width), imageHeight(height), colors(nullptr) {
-    colors = new Color[width * height];
-    for (size_t i = 0; i < width; i++) {
-        for (size_t j = 0; j < height; j++) {
-            *(colors + i * height + j) = color;
+template<typename Format>
+std::shared_ptr<typename BasicPixels<Format>::Value[]> BasicPixels<Format>::allocate(size_t size) const {
+    return Allocator::share<Value>(size, memoryBudget);
+}
+
+template<typename Format>
+uint64_t BasicPixels<Format>::footprint(size_t width, size_t height) {
+    if (width == 0 || height == 0) {
+        return 0;
+    }
+    // The rows, plus the background row that unwritten tiles read from.
+    const uint64_t most = MemoryBudget::unlimited;
+    const uint64_t rows = static_cast<uint64_t>(height) + 1;
+    if (width > most / rows || static_cast<uint64_t>(width) * rows > most / sizeof(Value)) {
+        return most;
+    }
+    return static_cast<uint64_t>(width) * rows * sizeof(Value);
+}
+
+template<typename Format>
+uint64_t BasicPixels<Format>::bytes() const {
+    if (externalMemory) {
+        return 0;
+    }
+    uint64_t result = backgroundRow != nullptr ? imageWidth * sizeof(Value) : 0;
+    for (size_t i = 0; i < tiles.size(); i++) {
+        if (tiles[i] != nullptr) {
+            result += tileSize(i) * sizeof(Value);
         }
     }
+    return result;
+}
+
+template<typename Format>
+void BasicPixels<Format>::setBudget(std::shared_ptr<MemoryBudget> budget) {
+    memoryBudget = std::move(budget);
 }
 
-Pixels::~Pixels() {
-    delete[] colors;
+template<typename Format>
+const std::shared_ptr<MemoryBudget>& BasicPixels<Format>::budget() const {
+    return memoryBudget;
 }
 
-size_t Pixels::height() const {
+template<typename Format>
+size_t BasicPixels<Format>::height() const {
     return imageHeight;
 }
 
-size_t Pixels::width() const {
+template<typename Format>
+size_t BasicPixels<Format>::width() const {
     return imageWidth;
 }
 
-void Pixels::set(int64_t x, int64_t y, const Color &color) {
-    if (x < 0 || y < 0 || x >= imageWidth || y >= imageHeight) {
+template<typename Format>
+typename BasicPixels<Format>::Storage BasicPixels<Format>::storage() const {
+    return storageType;
+}
+
+template<typename Format>
+bool BasicPixels<Format>::external() const {
+    return externalMemory;
+}
+
+template<typename Format>
+const typename BasicPixels<Format>::Value& BasicPixels<Format>::background() const {
+    return backgroundValue;
+}
+
+template<typename Format>
+bool BasicPixels<Format>::materialized(size_t y) const {
+    if (y >= imageHeight) {
+        throw std::invalid_argument("indexes were out of range");
+    }
+    return tiles[y >> tileShift] != nullptr;
+}
+
+template<typename Format>
+bool BasicPixels<Format>::dirty(size_t y) const {
+    if (y >= imageHeight) {
+        throw std::invalid_argument("indexes were out of range");
+    }
+    return (dirtyRows[y >> 6] >> (y & 63)) & 1;
+}
+
+template<typename Format>
+std::vector<std::pair<size_t, size_t>> BasicPixels<Format>::dirtyRanges() const {
+    std::vector<std::pair<size_t, size_t>> result;
+    for (size_t word = 0; word < dirtyRows.size(); word++) {
+        if (dirtyRows[word] == 0) {
+            continue;
+        }
+        for (size_t y = word * 64; y < std::min(imageHeight, word * 64 + 64); y++) {
+            if (!dirty(y)) {
+                continue;
+            }
+            if (!result.empty() && result.back().second == y) {
+                result.back().second = y + 1;
+            } else {
+                result.emplace_back(y, y + 1);
+            }
+        }
+    }
+    return result;
+}
+
+template<typename Format>
+void BasicPixels<Format>::checkpoint() {
+    std::fill(dirtyRows.begin(), dirtyRows.end(), 0);
+}
+
+template<typename Format>
+void BasicPixels<Format>::setClip(const Point<size_t>& lowerBound, const Point<size_t>& upperBound) {
+    clipLower = {std::min(lowerBound.x(), imageWidth), std::min(lowerBound.y(), imageHeight)};
+    clipUpper = {std::max(clipLower.x(), std::min(upperBound.x(), imageWidth)),
+                 std::max(clipLower.y(), std::min(upperBound.y(), imageHeight))};
+}
+
+template<typename Format>
+void BasicPixels<Format>::resetClip() {
+    clipLower = {0, 0};
+    clipUpper = {imageWidth, imageHeight};
+}
+
+template<typename Format>
+void BasicPixels<Format>::getClip(Point<size_t>& lowerBound, Point<size_t>& upperBound) const {
+    lowerBound = clipLower;
+    upperBound = clipUpper;
+}
+
+template<typename Format>
+bool BasicPixels<Format>::clipped() const {
+    return clipLower.x() != 0 || clipLower.y() != 0 || clipUpper.x() != imageWidth || clipUpper.y() != imageHeight;
+}
+
+template<typename Format>
+uint64_t BasicPixels<Format>::pixelsWritten() const {
+    return writtenPixels.get();
+}
+
+template<typename Format>
+uint64_t BasicPixels<Format>::pixelsClipped() const {
+    return clippedPixels.get();
+}
+
+#ifdef SGLIB_STATS
+template<typename Format>
+void BasicPixels<Format>::count(int64_t requested, int64_t written) {
+    writtenPixels.add(static_cast<uint64_t>(written));
+    clippedPixels.add(static_cast<uint64_t>(requested - written));
+}
+#else
+template<typename Format>
+void BasicPixels<Format>::count(int64_t, int64_t) { }
+#endif
+
+template<typename Format>
+void BasicPixels<Format>::trackWrites(bool enabled) {
+    writeCounts.assign(enabled ? imageWidth * imageHeight : 0, 0);
+    writeCounts.shrink_to_fit();
+}
+
+template<typename Format>
+bool BasicPixels<Format>::trackingWrites() const {
+    return !writeCounts.empty();
+}
+
+template<typename Format>
+uint32_t BasicPixels<Format>::writes(size_t x, size_t y) const {
+    if (x >= imageWidth || y >= imageHeight) {
+        throw std::invalid_argument("indexes were out of range");
+    }
+    return writeCounts.empty() ? 0 : writeCounts[y * imageWidth + x];
+}
+
+template<typename Format>
+void BasicPixels<Format>::countWrites(size_t y, size_t x0, size_t x1) {
+    if (writeCounts.empty()) {
+        return;
+    }
+    uint32_t* counts = writeCounts.data() + y * imageWidth;
+    for (size_t x = x0; x < x1; x++) {
+        counts[x]++;
+    }
+}
+
+template<typename Format>
+size_t BasicPixels<Format>::tileSize(size_t index) const {
+    const size_t first = index << tileShift;
+    return std::min(imageHeight - first, static_cast<size_t>(1) << tileShift) * imageWidth;
+}
+
+template<typename Format>
+void BasicPixels<Format>::ownTile(size_t index) {
+    std::shared_ptr<Value[]>& tile = tiles[index];
+    if (tile == nullptr) {
+        const size_t size = tileSize(index);
+        tile = allocate(size);
+        std::uninitialized_fill_n(tile.get(), size, backgroundValue);
+    } else if (tile.use_count() > 1 && !externalMemory) {
+        const size_t size = tileSize(index);
+        std::shared_ptr<Value[]> copy = allocate(size);
+        std::uninitialized_copy_n(tile.get(), size, copy.get());
+        tile = std::move(copy);
+    }
+}
+
+template<typename Format>
+typename BasicPixels<Format>::Value* BasicPixels<Format>::writableRow(size_t y) {
+    dirtyRows[y >> 6] |= static_cast<uint64_t>(1) << (y & 63);
+    const std::shared_ptr<Value[]>& tile = tiles[y >> tileShift];
+    if (tile == nullptr || (tile.use_count() > 1 && !externalMemory)) {
+        ownTile(y >> tileShift);
+    }
+    const size_t mask = (static_cast<size_t>(1) << tileShift) - 1;
+    return reinterpret_cast<Value*>(reinterpret_cast<uint8_t*>(tile.get()) + (y & mask) * rowStride);
+}
+
+template<typename Format>
+const typename BasicPixels<Format>::Value* BasicPixels<Format>::readableRow(size_t y) const {
+    const std::shared_ptr<Value[]>& tile = tiles[y >> tileShift];
+    if (tile == nullptr) {
+        return backgroundRow.get();
+    }
+    const size_t mask = (static_cast<size_t>(1) << tileShift) - 1;
+    return reinterpret_cast<Value*>(reinterpret_cast<uint8_t*>(tile.get()) + (y & mask) * rowStride);
+}
+
+template<typename Format>
+void BasicPixels<Format>::set(int64_t x, int64_t y, const Value& value) {
+    if (x < static_cast<int64_t>(clipLower.x()) || y < static_cast<int64_t>(clipLower.y()) ||
+        x >= static_cast<int64_t>(clipUpper.x()) || y >= static_cast<int64_t>(clipUpper.y())) {
+        count(1, 0);
         return;
     }
-    *(colors + x * imageHeight + y) = color;
+    count(1, 1);
+    countWrites(y, x, x + 1);
+    writableRow(y)[x] = value;
 }
 
-Color& Pixels::get(size_t x, size_t y) {
+template<typename Format>
+typename BasicPixels<Format>::Value& BasicPixels<Format>::get(size_t x, size_t y) {
     if (x >= imageWidth || y >= imageHeight) {
         throw std::invalid_argument("indexes were out of range");
     }
-    return *(colors + x * imageHeight + y);
+    return writableRow(y)[x];
 }
 
-const Color& Pixels::get(size_t x, size_t y) const {
+template<typename Format>
+const typename BasicPixels<Format>::Value& BasicPixels<Format>::get(size_t x, size_t y) const {
     if (x >= imageWidth || y >= imageHeight) {
         throw std::invalid_argument("indexes were out of range");
     }
-    return *(colors + x * imageHeight + y);
+    return readableRow(y)[x];
 }
 
-Pixels::Pixels(const Pixels &other) :
-        imageHeight(other.imageHeight),
-        imageWidth(other.imageWidth) {
+template<typename Format>
+typename BasicPixels<Format>::Value* BasicPixels<Format>::row(size_t y) {
+    if (y >= imageHeight) {
+        throw std::invalid_argument("indexes were out of range");
+    }
+    return writableRow(y);
+}
 
-    colors = new Color[imageHeight * imageWidth];
-    std::copy_n(other.colors, imageHeight * imageWidth, colors);
+template<typename Format>
+const typename BasicPixels<Format>::Value* BasicPixels<Format>::row(size_t y) const {
+    if (y >= imageHeight) {
+        throw std::invalid_argument("indexes were out of range");
+    }
+    return readableRow(y);
 }
 
-Pixels::Pixels(Pixels &&other) noexcept :
-               imageHeight(other.imageHeight),
-               imageWidth(other.imageWidth) {
+template<typename Format>
+BasicPixels<Format>::BasicPixels(BasicPixels&& other) noexcept :
+        imageWidth(other.imageWidth),
+        imageHeight(other.imageHeight),
+        rowStride(other.rowStride),
+        tileShift(other.tileShift),
+        storageType(other.storageType),
+        externalMemory(other.externalMemory),
+        memoryBudget(std::move(other.memoryBudget)),
+        backgroundValue(other.backgroundValue),
+        backgroundRow(std::move(other.backgroundRow)),
+        tiles(std::move(other.tiles)),
+        dirtyRows(std::move(other.dirtyRows)),
+        clipLower(other.clipLower),
+        clipUpper(other.clipUpper),
+        writtenPixels(other.writtenPixels),
+        clippedPixels(other.clippedPixels),
+        writeCounts(std::move(other.writeCounts)) {
     other.imageHeight = 0;
     other.imageWidth = 0;
-    colors = other.colors;
-    other.colors = nullptr;
+    other.clipLower = {0, 0};
+    other.clipUpper = {0, 0};
+    other.tiles.clear();
+    other.dirtyRows.clear();
 }
 
-Pixels& Pixels::operator=(Pixels &&other) noexcept {
+template<typename Format>
+BasicPixels<Format>& BasicPixels<Format>::operator=(BasicPixels&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
     imageHeight = other.imageHeight;
     imageWidth = other.imageWidth;
+    rowStride = other.rowStride;
+    tileShift = other.tileShift;
+    storageType = other.storageType;
+    externalMemory = other.externalMemory;
+    memoryBudget = std::move(other.memoryBudget);
+    backgroundValue = other.backgroundValue;
+    backgroundRow = std::move(other.backgroundRow);
+    tiles = std::move(other.tiles);
+    dirtyRows = std::move(other.dirtyRows);
+    clipLower = other.clipLower;
+    clipUpper = other.clipUpper;
+    writtenPixels = other.writtenPixels;
+    clippedPixels = other.clippedPixels;
+    writeCounts = std::move(other.writeCounts);
     other.imageHeight = 0;
     other.imageWidth = 0;
-    colors = other.colors;
-    other.colors = nullptr;
+    other.clipLower = {0, 0};
+    other.clipUpper = {0, 0};
+    other.tiles.clear();
+    other.dirtyRows.clear();
     return *this;
 }
 
-Pixels& Pixels::operator=(const Pixels &other) {
-    if (this == &other) {
+template<typename Format>
+BasicPixels<Format> BasicPixels<Format>::snapshot() const {
+    if (!externalMemory) {
         return *this;
     }
-    imageHeight = other.imageHeight;
-    imageWidth = other.imageWidth;
-    colors = new Color[imageHeight * imageWidth];
-    std::copy_n(other.colors, imageHeight * imageWidth, colors);
-    return *this;
+    BasicPixels result(imageWidth, imageHeight, backgroundValue, Storage::Contiguous, memoryBudget);
+    result.parallelRows(0, imageHeight, imageWidth * imageHeight, [&](size_t first, size_t last) {
+        for (size_t y = first; y < last; y++) {
+            std::copy_n(readableRow(y), imageWidth, result.writableRow(y));
+        }
+    });
+    result.dirtyRows = dirtyRows;
+    result.clipLower = clipLower;
+    result.clipUpper = clipUpper;
+    result.writeCounts = writeCounts;
+    return result;
 }
 
-bool Pixels::empty() const {
+template<typename Format>
+bool BasicPixels<Format>::empty() const {
     return imageWidth == 0 || imageHeight == 0;
 }
 
-void Pixels::setRangeIf(const Point<size_t>& lowerBound,
-                        const Point<size_t>& upperBound,
-                        const std::function<bool(size_t, size_t)>& function,
-                        const Color& color,
-                        const Point<size_t>& offset) {
-    for (size_t i = lowerBound.x(); i < upperBound.x(); i++) {
-        for (size_t j = lowerBound.y(); j < upperBound.y(); j++) {
+template<typename Format>
+void BasicPixels<Format>::parallelRows(size_t begin, size_t end, size_t cost,
+                                       const std::function<void(size_t, size_t)>& function) {
+    static_assert(bandRows % tileRows == 0 && bandRows % 64 == 0, "bands must not share tiles or dirty words");
+    if (cost >= Executor::parallelThreshold && storageType == Storage::Contiguous && !empty()) {
+        // The single tile would otherwise be allocated or copied by whichever band writes first.
+        ownTile(0);
+    }
+    Executor::parallelFor(begin, end, cost, function, bandRows);
+}
+
+template<typename Format>
+void BasicPixels<Format>::setRangeIf(const Point<size_t>& lowerBound,
+                                     const Point<size_t>& upperBound,
+                                     const std::function<bool(size_t, size_t)>& function,
+                                     const Value& value,
+                                     const Point<size_t>& offset) {
+    for (size_t j = lowerBound.y(); j < upperBound.y(); j++) {
+        for (size_t i = lowerBound.x(); i < upperBound.x(); i++) {
             if (function(i, j)) {
                 set(static_cast<int64_t>(i + offset.x()),
-                    static_cast<int64_t>(j + offset.y()), color);
+                    static_cast<int64_t>(j + offset.y()), value);
             }
         }
     }
 }
 
-void Pixels::setRange(const Point<size_t>& lowerBound,
-                      const Point<size_t>& upperBound, const Color& color) {
-    for (size_t i = lowerBound.x(); i < std::min(imageWidth, upperBound.x()); i++) {
-        for (size_t j = lowerBound.y(); j < std::min(imageHeight, upperBound.y()); j++) {
-            *(colors + i * imageHeight + j) = color;
+template<typename Format>
+void BasicPixels<Format>::setRange(const Point<size_t>& lowerBound,
+                                   const Point<size_t>& upperBound, const Value& value) {
+    const size_t left = std::max(clipLower.x(), lowerBound.x());
+    const size_t right = std::min(clipUpper.x(), upperBound.x());
+    const size_t top = std::max(clipLower.y(), lowerBound.y());
+    const size_t bottom = std::min(clipUpper.y(), upperBound.y());
+    count(upperBound.x() > lowerBound.x() && upperBound.y() > lowerBound.y() ?
+          static_cast<int64_t>((upperBound.x() - lowerBound.x()) * (upperBound.y() - lowerBound.y())) : 0,
+          left < right && top < bottom ? static_cast<int64_t>((right - left) * (bottom - top)) : 0);
+    if (left >= right || top >= bottom) {
+        return;
+    }
+    auto rows = [&](size_t first, size_t last) {
+        for (size_t j = first; j < last; j++) {
+            countWrites(j, left, right);
+            Value* line = writableRow(j);
+            std::fill(line + left, line + right, value);
+        }
+    };
+    // By reference: a std::function holding the lambda itself would allocate on every call.
+    parallelRows(top, bottom, (right - left) * (bottom - top), std::ref(rows));
+}
+
+template<typename Format>
+void BasicPixels<Format>::setSpan(int64_t y, int64_t x0, int64_t x1, const Value& value) {
+    const int64_t requested = std::max<int64_t>(0, x1 - x0);
+    x0 = std::max(static_cast<int64_t>(clipLower.x()), x0);
+    x1 = std::min(static_cast<int64_t>(clipUpper.x()), x1);
+    if (y < static_cast<int64_t>(clipLower.y()) || y >= static_cast<int64_t>(clipUpper.y()) || x0 >= x1) {
+        count(requested, 0);
+        return;
+    }
+    count(requested, x1 - x0);
+    countWrites(y, x0, x1);
+    Value* line = writableRow(y);
+    std::fill(line + x0, line + x1, value);
+}
+
+template<typename Format>
+void BasicPixels<Format>::copySpan(int64_t y, int64_t x0, int64_t x1, const Value* source) {
+    const int64_t requested = std::max<int64_t>(0, x1 - x0);
+    const int64_t left = std::max(static_cast<int64_t>(clipLower.x()), x0);
+    x1 = std::min(static_cast<int64_t>(clipUpper.x()), x1);
+    if (y < static_cast<int64_t>(clipLower.y()) || y >= static_cast<int64_t>(clipUpper.y()) || left >= x1) {
+        count(requested, 0);
+        return;
+    }
+    count(requested, x1 - left);
+    countWrites(y, left, x1);
+    std::copy(source + (left - x0), source + (x1 - x0), writableRow(y) + left);
+}
+
+template<typename Format>
+void BasicPixels<Format>::blend(int64_t x, int64_t y, const Value& value, uint8_t coverage) {
+    if (x < static_cast<int64_t>(clipLower.x()) || y < static_cast<int64_t>(clipLower.y()) ||
+        x >= static_cast<int64_t>(clipUpper.x()) || y >= static_cast<int64_t>(clipUpper.y()) || coverage == 0) {
+        count(coverage == 0 ? 0 : 1, 0);
+        return;
+    }
+    count(1, 1);
+    countWrites(y, x, x + 1);
+    Format::blend(writableRow(y)[x], value, coverage);
+}
+
+template<typename Format>
+void BasicPixels<Format>::blendSpan(int64_t y, int64_t x0, int64_t x1, const Value& value, uint8_t coverage) {
+    const int64_t requested = coverage == 0 ? 0 : std::max<int64_t>(0, x1 - x0);
+    x0 = std::max(static_cast<int64_t>(clipLower.x()), x0);
+    x1 = std::min(static_cast<int64_t>(clipUpper.x()), x1);
+    if (y < static_cast<int64_t>(clipLower.y()) || y >= static_cast<int64_t>(clipUpper.y()) || x0 >= x1 || coverage == 0) {
+        count(requested, 0);
+        return;
+    }
+    count(requested, x1 - x0);
+    countWrites(y, x0, x1);
+    Value* line = writableRow(y);
+    for (int64_t x = x0; x < x1; x++) {
+        Format::blend(line[x], value, coverage);
+    }
+}
+
+template<typename Format>
+void BasicPixels<Format>::fill(const Value& value) {
+    if (clipped() || externalMemory) {
+        setRange(clipLower, clipUpper, value);
+        return;
+    }
+    count(static_cast<int64_t>(imageWidth * imageHeight), static_cast<int64_t>(imageWidth * imageHeight));
+    if (trackingWrites()) {
+        for (size_t y = 0; y < imageHeight; y++) {
+            countWrites(y, 0, imageWidth);
         }
     }
+    backgroundValue = value;
+    backgroundRow.reset();
+    if (!empty()) {
+        backgroundRow = allocate(imageWidth);
+        std::uninitialized_fill_n(backgroundRow.get(), imageWidth, value);
+    }
+    std::fill(tiles.begin(), tiles.end(), nullptr);
+    std::fill(dirtyRows.begin(), dirtyRows.end(), ~static_cast<uint64_t>(0));
+}
+
+template<typename Format>
+void BasicPixels<Format>::blit(const BasicPixels& source, int64_t x, int64_t y) {
+    const int64_t left = std::max(static_cast<int64_t>(clipLower.x()), x);
+    const int64_t top = std::max(static_cast<int64_t>(clipLower.y()), y);
+    const int64_t right = std::min(static_cast<int64_t>(clipUpper.x()),
+                                   x + static_cast<int64_t>(source.imageWidth));
+    const int64_t bottom = std::min(static_cast<int64_t>(clipUpper.y()),
+                                    y + static_cast<int64_t>(source.imageHeight));
+    count(static_cast<int64_t>(source.imageWidth * source.imageHeight),
+          left < right && top < bottom ? (right - left) * (bottom - top) : 0);
+    if (left >= right) {
+        return;
+    }
+    auto rows = [&](size_t first, size_t last) {
+        for (auto j = static_cast<int64_t>(first); j < static_cast<int64_t>(last); j++) {
+            countWrites(j, left, right);
+            std::copy_n(source.readableRow(j - y) + (left - x), right - left, writableRow(j) + left);
+        }
+    };
+    parallelRows(static_cast<size_t>(top), static_cast<size_t>(bottom),
+                 static_cast<size_t>((right - left) * (bottom - top)), std::ref(rows));
 }
+
+template class sglib::BasicPixels<Gray8>;
+template class sglib::BasicPixels<Rgb24>;
+template class sglib::BasicPixels<Rgba32>;
@@ -1,36 +1,191 @@
 #pragma once
+#include "Allocator.h"
 #include "Color.h"
+#include "Executor.h"
+#include "PixelFormat.h"
 #include "Point.h"
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <vector>
 
 namespace sglib {
-    class Pixels {
+    // Caller-owned pixel memory. `stride` is the distance in bytes between the starts of
+    // consecutive rows; 0 means rows are tightly packed.
+    template<typename Format>
+    class BasicPixelsView {
     public:
-        Pixels() : imageHeight(0), imageWidth(0), colors(nullptr) { }
-        Pixels(size_t width, size_t height);
-        Pixels(size_t width, size_t height, const Color& color);
-        Pixels(const Pixels& other);
-        Pixels(Pixels&& other) noexcept;
-        Pixels& operator=(const Pixels& other);
-        Pixels& operator=(Pixels&& other) noexcept;
-        ~Pixels();
+        using Value = typename Format::Value;
+
+        BasicPixelsView(Value* data, size_t width, size_t height, size_t stride = 0) :
+                data(data), width(width), height(height), stride(stride == 0 ? width * sizeof(Value) : stride) { }
+
+        Value* data;
+        size_t width, height, stride;
+    };
+
+    template<typename Format>
+    class BasicPixels {
+    public:
+        using Value = typename Format::Value;
+
+        // Tiled storage splits the image into bands of full-width rows that are shared between
+        // copies and duplicated on first write, so copies and snapshots cost O(number of tiles).
+        // Tiles are only allocated when first written; until then they read as the background.
+        enum class Storage {
+            Contiguous,
+            Tiled
+        };
+
+        const static size_t tileRows = 32;
+        // Row bands handed out by parallelRows() start at multiples of this.
+        const static size_t bandRows = 64;
+
+        BasicPixels() : imageWidth(0), imageHeight(0), rowStride(0), tileShift(0), storageType(Storage::Contiguous),
+                        externalMemory(false), backgroundValue(), clipLower(0, 0), clipUpper(0, 0), writtenPixels(0),
+                        clippedPixels(0) { }
+        // Throws BudgetExceeded up front when the whole image, every tile written, would not fit
+        // in what is left of the process budget or of `budget`; see setBudget().
+        BasicPixels(size_t width, size_t height, Storage storage = Storage::Contiguous);
+        BasicPixels(size_t width, size_t height, const Value& value, Storage storage = Storage::Contiguous,
+                    std::shared_ptr<MemoryBudget> budget = nullptr);
+        // Draws straight into the caller's memory, which must outlive this object and its copies.
+        // Copies share that memory too; snapshot() is the way to get an owning copy.
+        explicit BasicPixels(const BasicPixelsView<Format>& view);
+        BasicPixels(const BasicPixels& other) = default;
+        BasicPixels(BasicPixels&& other) noexcept;
+        BasicPixels& operator=(const BasicPixels& other) = default;
+        BasicPixels& operator=(BasicPixels&& other) noexcept;
+        ~BasicPixels() = default;
 
         size_t height() const;
         size_t width() const;
-        void set(int64_t x, int64_t y, const Color& color);
-        void setRange(const Point<size_t>& lowerBound, const Point<size_t>& upperBound, const Color& color);
+        Storage storage() const;
+        bool external() const;
+        const Value& background() const;
+        bool materialized(size_t y) const;
+        // Bytes of pixel memory this object holds, tiles shared with copies included.
+        uint64_t bytes() const;
+        // Bytes an image of that size takes once every tile is written, which the constructors
+        // check against the budgets. Saturates rather than overflowing.
+        static uint64_t footprint(size_t width, size_t height);
+        // Tiles allocated from now on, here and in copies made from now on, are charged to
+        // `budget` as well as to the process budget, until they are freed. nullptr charges only
+        // the process budget.
+        void setBudget(std::shared_ptr<MemoryBudget> budget);
+        const std::shared_ptr<MemoryBudget>& budget() const;
+        // Rows written since the last checkpoint(), as half-open [first, second) ranges.
+        bool dirty(size_t y) const;
+        std::vector<std::pair<size_t, size_t>> dirtyRanges() const;
+        void checkpoint();
+        // Every writer below, fill() and blit() included, only touches pixels inside the clip:
+        // the half-open rectangle [lowerBound, upperBound), which is the whole image by default.
+        void setClip(const Point<size_t>& lowerBound, const Point<size_t>& upperBound);
+        void resetClip();
+        void getClip(Point<size_t>& lowerBound, Point<size_t>& upperBound) const;
+        bool clipped() const;
+        // Pixels stored and pixels dropped by the clip so far, counted by every writer below when
+        // the library is built with SGLIB_STATS; always zero otherwise.
+        uint64_t pixelsWritten() const;
+        uint64_t pixelsClipped() const;
+        // Counts how often each pixel is stored by the writers below, from zero, until disabled.
+        void trackWrites(bool enabled);
+        bool trackingWrites() const;
+        // Zero when writes are not tracked.
+        uint32_t writes(size_t x, size_t y) const;
+        void set(int64_t x, int64_t y, const Value& value);
+        void setRange(const Point<size_t>& lowerBound, const Point<size_t>& upperBound, const Value& value);
+        void setSpan(int64_t y, int64_t x0, int64_t x1, const Value& value);
+        void copySpan(int64_t y, int64_t x0, int64_t x1, const Value* source);
+        void blend(int64_t x, int64_t y, const Value& value, uint8_t coverage);
+        void blendSpan(int64_t y, int64_t x0, int64_t x1, const Value& value, uint8_t coverage);
         void setRangeIf(const Point<size_t>& lowerBound,
             const Point<size_t>& upperBound,
             const std::function<bool(size_t, size_t)>& function,
-            const Color& color,
+            const Value& value,
             const Point<size_t>& offset = {0, 0});
-        Color& get(size_t x, size_t y);
-        const Color& get(size_t x, size_t y) const;
+        void fill(const Value& value);
+        void blit(const BasicPixels& source, int64_t x, int64_t y);
+        // Runs function(first, last) over bands of the rows [begin, end), in parallel on the
+        // Executor when `cost` is large enough. Bands never share a tile or dirty-row word, so
+        // each band may write its own rows through any writer or row() while the others run.
+        void parallelRows(size_t begin, size_t end, size_t cost, const std::function<void(size_t, size_t)>& function);
+        template<typename Target>
+        BasicPixels<Target> convert() const;
+        BasicPixels snapshot() const;
+        Value& get(size_t x, size_t y);
+        const Value& get(size_t x, size_t y) const;
+        // Pointers returned by the non-const overload must not be kept across snapshot() or copies.
+        Value* row(size_t y);
+        const Value* row(size_t y) const;
         bool empty() const;
 
     private:
         size_t imageWidth;
         size_t imageHeight;
-        Color* colors;
+        size_t rowStride;
+        size_t tileShift;
+        Storage storageType;
+        bool externalMemory;
+        std::shared_ptr<MemoryBudget> memoryBudget;
+        Value backgroundValue;
+        std::shared_ptr<Value[]> backgroundRow;
+        std::vector<std::shared_ptr<Value[]>> tiles;
+        std::vector<uint64_t> dirtyRows;
+        Point<size_t> clipLower, clipUpper;
+        // Copyable counter that row bands running in parallel can bump.
+        class Counter {
+        public:
+            Counter(uint64_t value = 0) : value(value) { }
+            Counter(const Counter& other) : value(other.get()) { }
+            Counter& operator=(const Counter& other) {
+                value.store(other.get(), std::memory_order_relaxed);
+                return *this;
+            }
+            void add(uint64_t amount) {
+                value.fetch_add(amount, std::memory_order_relaxed);
+            }
+            uint64_t get() const {
+                return value.load(std::memory_order_relaxed);
+            }
+
+        private:
+            std::atomic<uint64_t> value;
+        };
+
+        Counter writtenPixels, clippedPixels;
+        // One counter per pixel, row after row; empty unless writes are tracked.
+        std::vector<uint32_t> writeCounts;
+
+        std::shared_ptr<Value[]> allocate(size_t size) const;
+        size_t tileSize(size_t index) const;
+        void ownTile(size_t index);
+        Value* writableRow(size_t y);
+        const Value* readableRow(size_t y) const;
+        void count(int64_t requested, int64_t written);
+        void countWrites(size_t y, size_t x0, size_t x1);
     };
+
+    using Pixels = BasicPixels<Rgba32>;
+    using RgbPixels = BasicPixels<Rgb24>;
+    using GrayPixels = BasicPixels<Gray8>;
+    using PixelsView = BasicPixelsView<Rgba32>;
+    using RgbPixelsView = BasicPixelsView<Rgb24>;
+    using GrayPixelsView = BasicPixelsView<Gray8>;
+
+    template<typename Format>
+    template<typename Target>
+    BasicPixels<Target> BasicPixels<Format>::convert() const {
+        auto storage = static_cast<typename BasicPixels<Target>::Storage>(storageType);
+        BasicPixels<Target> result(imageWidth, imageHeight,
+                                   Target::fromColor(Format::toColor(backgroundValue)), storage, memoryBudget);
+        result.parallelRows(0, imageHeight, imageWidth * imageHeight, [&](size_t first, size_t last) {
+            for (size_t y = first; y < last; y++) {
+                if (materialized(y)) {
+                    FormatConverter<Format, Target>::convert(row(y), result.row(y), imageWidth);
+                }
+            }
+        });
+        return result;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include "Rasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace sglib;
+
+void Rasterizer::addContour(const Point<float>* points, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        addEdge(points[i], points[(i + 1) % count]);
+    }
+}
+
+void Rasterizer::addEdge(const Point<float>& start, const Point<float>& finish) {
+    if (start.y() == finish.y()) {
+        return;
+    }
+    Edge edge{};
+    edge.direction = start.y() < finish.y() ? 1 : -1;
+    const Point<float>& upper = edge.direction > 0 ? start : finish;
+    const Point<float>& lower = edge.direction > 0 ? finish : start;
+    edge.x0 = upper.x();
+    edge.y0 = upper.y();
+    edge.y1 = lower.y();
+    edge.slope = (lower.x() - upper.x()) / (lower.y() - upper.y());
+    edges.push_back(edge);
+}
+
+void Rasterizer::rasterize(size_t width, size_t height, FillRule rule,
+                           const std::function<void(int64_t, int64_t, int64_t)>& span) {
+    const auto rows = static_cast<int64_t>(height);
+    const auto columns = static_cast<int64_t>(width);
+    for (auto& edge : edges) {
+        edge.firstRow = std::max<int64_t>(0, static_cast<int64_t>(ceilf(edge.y0 - 0.5f)));
+        edge.lastRow = std::min(rows, static_cast<int64_t>(ceilf(edge.y1 - 0.5f)));
+        edge.x = edge.x0 + (static_cast<float>(edge.firstRow) + 0.5f - edge.y0) * edge.slope;
+    }
+    std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+        return a.firstRow < b.firstRow;
+    });
+
+    active.clear();
+    size_t next = 0;
+    int64_t row = 0;
+    while (row < rows && (next < edges.size() || !active.empty())) {
+        if (active.empty()) {
+            row = std::max(row, edges[next].firstRow);
+            if (row >= rows) {
+                break;
+            }
+        }
+        while (next < edges.size() && edges[next].firstRow <= row) {
+            active.push_back(&edges[next]);
+            next++;
+        }
+        active.erase(std::remove_if(active.begin(), active.end(), [row](const Edge* edge) {
+            return edge->lastRow <= row;
+        }), active.end());
+
+        for (size_t i = 1; i < active.size(); i++) {
+            Edge* edge = active[i];
+            size_t j = i;
+            for (; j > 0 && active[j - 1]->x > edge->x; j--) {
+                active[j] = active[j - 1];
+            }
+            active[j] = edge;
+        }
+
+        int winding = 0;
+        float start = 0.0f;
+        for (Edge* edge : active) {
+            const bool wasInside = rule == FillRule::EvenOdd ? (winding & 1) != 0 : winding != 0;
+            winding += rule == FillRule::EvenOdd ? 1 : edge->direction;
+            const bool inside = rule == FillRule::EvenOdd ? (winding & 1) != 0 : winding != 0;
+            if (!wasInside && inside) {
+                start = edge->x;
+            } else if (wasInside && !inside) {
+                const int64_t left = std::max<int64_t>(0, static_cast<int64_t>(ceilf(start - 0.5f)));
+                const int64_t right = std::min(columns, static_cast<int64_t>(ceilf(edge->x - 0.5f)));
+                if (left < right) {
+                    span(row, left, right);
+                }
+            }
+        }
+
+        for (Edge* edge : active) {
+            edge->x += edge->slope;
+        }
+        row++;
+    }
+}
+
+void Rasterizer::rasterizeCoverage(size_t width, size_t height, FillRule rule,
+                                   const std::function<void(int64_t, int64_t, int64_t, uint8_t)>& span) {
+    const auto rows = static_cast<int64_t>(height);
+    const auto columns = static_cast<int64_t>(width);
+    cells.clear();
+    for (const auto& edge : edges) {
+        accumulate(edge, columns, rows);
+    }
+    std::sort(cells.begin(), cells.end(), [](const Cell& a, const Cell& b) {
+        return a.y < b.y || (a.y == b.y && a.x < b.x);
+    });
+
+    auto coverage = [rule](float value) {
+        value = std::abs(value);
+        if (rule == FillRule::EvenOdd) {
+            value = fmodf(value, 2.0f);
+            value = value > 1.0f ? 2.0f - value : value;
+        } else {
+            value = std::min(value, 1.0f);
+        }
+        return static_cast<uint8_t>(lroundf(value * 255.0f));
+    };
+
+    size_t i = 0;
+    while (i < cells.size()) {
+        const int64_t row = cells[i].y;
+        float accumulated = 0.0f;
+        while (i < cells.size() && cells[i].y == row) {
+            const int64_t x = cells[i].x;
+            float cover = 0.0f;
+            float area = 0.0f;
+            for (; i < cells.size() && cells[i].y == row && cells[i].x == x; i++) {
+                cover += cells[i].cover;
+                area += cells[i].area;
+            }
+            if (x >= 0) {
+                const uint8_t alpha = coverage(accumulated + area);
+                if (alpha != 0) {
+                    span(row, x, x + 1, alpha);
+                }
+            }
+            accumulated += cover;
+            const int64_t next = i < cells.size() && cells[i].y == row ? cells[i].x : columns;
+            if (x + 1 < next) {
+                const uint8_t alpha = coverage(accumulated);
+                if (alpha != 0) {
+                    span(row, x + 1, next, alpha);
+                }
+            }
+        }
+    }
+}
+
+void Rasterizer::accumulate(const Edge& edge, int64_t width, int64_t height) {
+    const int64_t firstRow = std::max<int64_t>(0, static_cast<int64_t>(floorf(edge.y0)));
+    const int64_t lastRow = std::min(height, static_cast<int64_t>(ceilf(edge.y1)));
+    const auto direction = static_cast<float>(edge.direction);
+    for (int64_t row = firstRow; row < lastRow; row++) {
+        const float top = std::max(edge.y0, static_cast<float>(row));
+        const float bottom = std::min(edge.y1, static_cast<float>(row + 1));
+        if (bottom <= top) {
+            continue;
+        }
+        accumulateRow(row, edge.x0 + (top - edge.y0) * edge.slope, top,
+                      edge.x0 + (bottom - edge.y0) * edge.slope, bottom, direction, width);
+    }
+}
+
+// Splits the piece of an edge inside one row at the cell boundaries it crosses. Each cell gets the
+// signed height of its piece as cover and the part of that cover lying right of the piece as area.
+// Everything left of the canvas only matters through its cover, so it collapses into cell -1.
+void Rasterizer::accumulateRow(int64_t row, float xa, float ya, float xb, float yb, float direction,
+                               int64_t width) {
+    const float left = std::min(xa, xb);
+    const float right = std::max(xa, xb);
+    const float columns = static_cast<float>(width);
+    auto yAt = [&](float x) {
+        return xa == xb ? ya : ya + (x - xa) * (yb - ya) / (xb - xa);
+    };
+    if (left >= columns) {
+        return;
+    }
+    if (right <= 0.0f) {
+        addCell(-1, row, direction * (yb - ya), 0.0f);
+        return;
+    }
+    if (left < 0.0f) {
+        addCell(-1, row, direction * std::abs(yAt(0.0f) - yAt(left)), 0.0f);
+    }
+    const float from = std::max(left, 0.0f);
+    const float to = std::min(right, columns);
+    if (from == to) {
+        const auto x = static_cast<int64_t>(floorf(from));
+        const float fraction = from - static_cast<float>(x);
+        addCell(x, row, direction * (yb - ya), direction * (yb - ya) * (1.0f - fraction));
+        return;
+    }
+    const auto firstColumn = static_cast<int64_t>(floorf(from));
+    const auto lastColumn = static_cast<int64_t>(ceilf(to));
+    for (int64_t x = firstColumn; x < lastColumn; x++) {
+        const float cellLeft = std::max(from, static_cast<float>(x));
+        const float cellRight = std::min(to, static_cast<float>(x + 1));
+        const float cover = direction * std::abs(yAt(cellRight) - yAt(cellLeft));
+        const float middle = (cellLeft + cellRight) / 2.0f - static_cast<float>(x);
+        addCell(x, row, cover, cover * (1.0f - middle));
+    }
+}
+
+void Rasterizer::addCell(int64_t x, int64_t y, float cover, float area) {
+    if (cover == 0.0f) {
+        return;
+    }
+    if (!cells.empty() && cells.back().x == x && cells.back().y == y) {
+        cells.back().cover += cover;
+        cells.back().area += area;
+        return;
+    }
+    cells.push_back({x, y, cover, area});
+}
+
+void Rasterizer::clear() {
+    edges.clear();
+    active.clear();
+    cells.clear();
+}
+
+bool Rasterizer::empty() const {
+    return edges.empty();
+}
+
+bool Rasterizer::getBounds(Point<float>& lowerBound, Point<float>& upperBound) const {
+    if (edges.empty()) {
+        return false;
+    }
+    float left = std::numeric_limits<float>::infinity();
+    float right = -left;
+    float top = left;
+    float bottom = right;
+    for (const auto& edge : edges) {
+        const float x1 = edge.x0 + (edge.y1 - edge.y0) * edge.slope;
+        left = std::min(left, std::min(edge.x0, x1));
+        right = std::max(right, std::max(edge.x0, x1));
+        top = std::min(top, edge.y0);
+        bottom = std::max(bottom, edge.y1);
+    }
+    lowerBound = {left, top};
+    upperBound = {right, bottom};
+    return true;
+}
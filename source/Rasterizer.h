@@ -0,0 +1,55 @@
+#pragma once
+#include "Point.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace sglib {
+    class Rasterizer {
+    public:
+        enum class FillRule {
+            EvenOdd,
+            NonZero
+        };
+
+        void addContour(const Point<float>* points, size_t count);
+        void addEdge(const Point<float>& start, const Point<float>& finish);
+        // Emits the half-open spans [x0, x1) of row y whose pixel centers are inside the contours,
+        // already clipped to [0, width) x [0, height).
+        void rasterize(size_t width, size_t height, FillRule rule,
+                       const std::function<void(int64_t, int64_t, int64_t)>& span);
+        // Anti-aliased variant: every pixel gets the exact area of it covered by the contours. Pixels
+        // crossed by an edge come out one at a time, the runs between them as single spans, so a
+        // coverage of 255 marks a solid interior span. Zero-coverage runs are skipped.
+        void rasterizeCoverage(size_t width, size_t height, FillRule rule,
+                               const std::function<void(int64_t, int64_t, int64_t, uint8_t)>& span);
+        void clear();
+        bool empty() const;
+        // Bounds of the edges added so far; horizontal edges are dropped and do not count.
+        bool getBounds(Point<float>& lowerBound, Point<float>& upperBound) const;
+
+    private:
+        class Edge {
+        public:
+            float x0, y0, y1;
+            float slope;
+            int direction;
+            int64_t firstRow, lastRow;
+            float x;
+        };
+
+        class Cell {
+        public:
+            int64_t x, y;
+            float cover, area;
+        };
+
+        std::vector<Edge> edges;
+        std::vector<Edge*> active;
+        std::vector<Cell> cells;
+
+        void accumulate(const Edge& edge, int64_t width, int64_t height);
+        void accumulateRow(int64_t row, float xa, float ya, float xb, float yb, float direction, int64_t width);
+        void addCell(int64_t x, int64_t y, float cover, float area);
+    };
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Messages between sgrenderd and its clients over a Unix stream socket. Every message is a
+// frame: a 4-byte little-endian payload length, a kind byte, then the payload. A client may
+// send any number of requests before reading; responses come back in request order.
+namespace sglib {
+    namespace protocol {
+        const char* const defaultSocket = "/tmp/sgrenderd.sock";
+        // Larger frames are refused, and the connection closed, rather than allocated.
+        const uint32_t maximumFrame = 1u << 28;
+
+        enum class Request : uint8_t {
+            // Payload: a scene in either Scene form. Answered with a Bitmap or an Error.
+            Render24,
+            Render32,
+            // No payload. Answered with Stats holding the daemon counters as JSON.
+            Stats
+        };
+
+        enum class Response : uint8_t {
+            Bitmap,
+            Error,
+            Stats
+        };
+
+        inline bool readFully(int socket, void* data, size_t size) {
+            auto* bytes = static_cast<uint8_t*>(data);
+            while (size > 0) {
+                const ssize_t got = ::read(socket, bytes, size);
+                if (got < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (got <= 0) {
+                    return false;
+                }
+                bytes += got;
+                size -= static_cast<size_t>(got);
+            }
+            return true;
+        }
+
+        inline bool writeFully(int socket, const void* data, size_t size) {
+            const auto* bytes = static_cast<const uint8_t*>(data);
+            while (size > 0) {
+                const ssize_t sent = ::send(socket, bytes, size, MSG_NOSIGNAL);
+                if (sent < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (sent <= 0) {
+                    return false;
+                }
+                bytes += sent;
+                size -= static_cast<size_t>(sent);
+            }
+            return true;
+        }
+
+        // False on a closed connection or a frame over maximumFrame.
+        inline bool readFrame(int socket, uint8_t& kind, std::string& payload) {
+            uint8_t header[5];
+            if (!readFully(socket, header, sizeof(header))) {
+                return false;
+            }
+            const uint32_t size = header[0] | header[1] << 8 | header[2] << 16 | static_cast<uint32_t>(header[3]) << 24;
+            if (size > maximumFrame) {
+                return false;
+            }
+            kind = header[4];
+            payload.resize(size);
+            return readFully(socket, &payload[0], size);
+        }
+
+        // False on a closed connection, or without sending anything for a payload over maximumFrame,
+        // whose length would not survive the trip.
+        inline bool writeFrame(int socket, uint8_t kind, const std::string& payload) {
+            if (payload.size() > maximumFrame) {
+                return false;
+            }
+            const auto size = static_cast<uint32_t>(payload.size());
+            const uint8_t header[5] = {static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8),
+                                       static_cast<uint8_t>(size >> 16), static_cast<uint8_t>(size >> 24), kind};
+            return writeFully(socket, header, sizeof(header)) && writeFully(socket, payload.data(), payload.size());
+        }
+
+        inline sockaddr_un address(const std::string& path) {
+            sockaddr_un result{};
+            if (path.size() >= sizeof(result.sun_path)) {
+                throw std::invalid_argument("socket path is too long");
+            }
+            result.sun_family = AF_UNIX;
+            std::memcpy(result.sun_path, path.c_str(), path.size() + 1);
+            return result;
+        }
+
+        inline int connect(const std::string& path) {
+            const sockaddr_un target = address(path);
+            const int socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (socket < 0) {
+                throw std::runtime_error(std::string("cannot create a socket: ") + std::strerror(errno));
+            }
+            if (::connect(socket, reinterpret_cast<const sockaddr*>(&target), sizeof(target)) != 0) {
+                const int error = errno;
+                ::close(socket);
+                throw std::runtime_error("cannot connect to " + path + ": " + std::strerror(error));
+            }
+            return socket;
+        }
+    }
+}
@@ -0,0 +1,233 @@
+#include "Resampler.h"
+#include "Executor.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+using namespace sglib;
+
+namespace {
+    const size_t channels = 4;
+
+    float sinc(float x) {
+        if (x == 0.0f) {
+            return 1.0f;
+        }
+        const float value = static_cast<float>(M_PI) * x;
+        return sinf(value) / value;
+    }
+
+    float support(Resampler::Filter filter) {
+        if (filter == Resampler::Filter::Box) {
+            return 0.5f;
+        } else if (filter == Resampler::Filter::Bilinear) {
+            return 1.0f;
+        }
+        return 3.0f;
+    }
+
+    float weight(Resampler::Filter filter, float pixel, float center, float filterScale) {
+        if (filter == Resampler::Filter::Box) {
+            const float left = std::max(pixel, center - filterScale / 2.0f);
+            const float right = std::min(pixel + 1.0f, center + filterScale / 2.0f);
+            return std::max(0.0f, right - left);
+        }
+        const float t = std::abs(pixel + 0.5f - center) / filterScale;
+        if (filter == Resampler::Filter::Bilinear) {
+            return std::max(0.0f, 1.0f - t);
+        }
+        return t < 3.0f ? sinc(t) * sinc(t / 3.0f) : 0.0f;
+    }
+}
+
+Resampler::Resampler(Filter filter, size_t threads) : filter_(filter), threads_(threads) {
+    if (threads_ == 0) {
+        threads_ = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+void Resampler::Plane::reset(size_t planeWidth, size_t planeHeight) {
+    width = planeWidth;
+    height = planeHeight;
+    values.resize(width * height * channels);
+}
+
+float* Resampler::Plane::row(size_t y) {
+    return values.data() + y * width * channels;
+}
+
+const float* Resampler::Plane::row(size_t y) const {
+    return values.data() + y * width * channels;
+}
+
+Resampler::Weights::Weights(Filter filter, size_t sourceSize, size_t destinationSize) {
+    const float scale = static_cast<float>(sourceSize) / static_cast<float>(destinationSize);
+    const float filterScale = std::max(scale, 1.0f);
+    const float radius = support(filter) * filterScale;
+    taps_ = std::min(sourceSize, static_cast<size_t>(ceilf(radius * 2.0f)) + 2);
+
+    starts.resize(destinationSize);
+    values.assign(destinationSize * taps_, 0.0f);
+    for (size_t i = 0; i < destinationSize; i++) {
+        const float center = (static_cast<float>(i) + 0.5f) * scale;
+        const auto left = static_cast<int64_t>(floorf(center - radius));
+        const size_t start = std::min(static_cast<size_t>(std::max<int64_t>(0, left)),
+                                      sourceSize - taps_);
+        float* row = values.data() + i * taps_;
+        float sum = 0.0f;
+        for (size_t k = 0; k < taps_; k++) {
+            row[k] = weight(filter, static_cast<float>(start + k), center, filterScale);
+            sum += row[k];
+        }
+        if (sum == 0.0f) {
+            const size_t nearest = std::min(std::max(static_cast<size_t>(center), start), start + taps_ - 1);
+            row[nearest - start] = 1.0f;
+            sum = 1.0f;
+        }
+        for (size_t k = 0; k < taps_; k++) {
+            row[k] /= sum;
+        }
+        starts[i] = start;
+    }
+}
+
+size_t Resampler::Weights::taps() const {
+    return taps_;
+}
+
+size_t Resampler::Weights::start(size_t index) const {
+    return starts[index];
+}
+
+const float* Resampler::Weights::get(size_t index) const {
+    return values.data() + index * taps_;
+}
+
+Pixels Resampler::resize(const Pixels& source, size_t width, size_t height) const {
+    if (source.empty()) {
+        throw std::invalid_argument("cannot resize empty pixels");
+    }
+    Pixels result(width, height);
+    if (result.empty()) {
+        return result;
+    }
+    Plane input, intermediate, output;
+    load(source, input);
+    resample(input, intermediate, output, width, height);
+    store(output, result);
+    return result;
+}
+
+std::vector<Pixels> Resampler::mipChain(const Pixels& source, size_t levels) const {
+    if (source.empty()) {
+        throw std::invalid_argument("cannot resize empty pixels");
+    }
+    std::vector<Pixels> result;
+    Plane current, intermediate, next;
+    load(source, current);
+    while ((current.width > 1 || current.height > 1) && (levels == 0 || result.size() < levels)) {
+        const size_t width = std::max<size_t>(1, current.width / 2);
+        const size_t height = std::max<size_t>(1, current.height / 2);
+        resample(current, intermediate, next, width, height);
+        result.emplace_back(width, height);
+        store(next, result.back());
+        std::swap(current, next);
+    }
+    return result;
+}
+
+void Resampler::load(const Pixels& source, Plane& plane) const {
+    plane.reset(source.width(), source.height());
+    parallel(plane.height, plane.width * plane.height, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+            float* row = plane.row(y);
+            for (size_t x = 0; x < plane.width; x++) {
+                const Color& color = source.get(x, y);
+                const float alpha = static_cast<float>(color.a()) / 255.0f;
+                row[x * channels] = static_cast<float>(color.r()) * alpha;
+                row[x * channels + 1] = static_cast<float>(color.g()) * alpha;
+                row[x * channels + 2] = static_cast<float>(color.b()) * alpha;
+                row[x * channels + 3] = static_cast<float>(color.a());
+            }
+        }
+    });
+}
+
+void Resampler::store(const Plane& plane, Pixels& destination) const {
+    parallel(plane.height, plane.width * plane.height, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+            const float* row = plane.row(y);
+            for (size_t x = 0; x < plane.width; x++) {
+                const float alpha = std::min(255.0f, std::max(0.0f, row[x * channels + 3]));
+                const float factor = alpha > 0.0f ? 255.0f / alpha : 0.0f;
+                auto channel = [&](size_t index) {
+                    const float value = row[x * channels + index] * factor;
+                    return static_cast<uint8_t>(roundf(std::min(255.0f, std::max(0.0f, value))));
+                };
+                destination.get(x, y) = Color(Color::Rgb(channel(0), channel(1), channel(2)),
+                                              static_cast<uint8_t>(roundf(alpha)));
+            }
+        }
+    });
+}
+
+void Resampler::resample(const Plane& source, Plane& intermediate, Plane& destination,
+                         size_t width, size_t height) const {
+    const Weights horizontalWeights(filter_, source.width, width);
+    const Weights verticalWeights(filter_, source.height, height);
+    intermediate.reset(width, source.height);
+    destination.reset(width, height);
+    horizontal(source, intermediate, horizontalWeights);
+    vertical(intermediate, destination, verticalWeights);
+}
+
+void Resampler::horizontal(const Plane& source, Plane& destination, const Weights& weights) const {
+    const size_t taps = weights.taps();
+    parallel(destination.height, destination.width * destination.height * taps,
+             [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+            const float* input = source.row(y);
+            float* output = destination.row(y);
+            for (size_t x = 0; x < destination.width; x++) {
+                const float* w = weights.get(x);
+                const float* pixel = input + weights.start(x) * channels;
+                float sum[channels] = {0.0f, 0.0f, 0.0f, 0.0f};
+                for (size_t k = 0; k < taps; k++) {
+                    for (size_t c = 0; c < channels; c++) {
+                        sum[c] += w[k] * pixel[k * channels + c];
+                    }
+                }
+                std::copy_n(sum, channels, output + x * channels);
+            }
+        }
+    });
+}
+
+void Resampler::vertical(const Plane& source, Plane& destination, const Weights& weights) const {
+    const size_t taps = weights.taps();
+    const size_t rowSize = destination.width * channels;
+    parallel(destination.height, destination.width * destination.height * taps,
+             [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+            float* output = destination.row(y);
+            std::fill_n(output, rowSize, 0.0f);
+            const float* w = weights.get(y);
+            for (size_t k = 0; k < taps; k++) {
+                if (w[k] == 0.0f) {
+                    continue;
+                }
+                const float* input = source.row(weights.start(y) + k);
+                const float factor = w[k];
+                for (size_t i = 0; i < rowSize; i++) {
+                    output[i] += factor * input[i];
+                }
+            }
+        }
+    });
+}
+
+void Resampler::parallel(size_t count, size_t cost,
+                         const std::function<void(size_t, size_t)>& function) const {
+    Executor::parallelFor(0, count, cost, function, 1, threads_);
+}
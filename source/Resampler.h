@@ -0,0 +1,58 @@
+#pragma once
+#include "Pixels.h"
+#include <functional>
+#include <vector>
+
+namespace sglib {
+    class Resampler {
+    public:
+        enum class Filter {
+            Box,
+            Bilinear,
+            Lanczos3
+        };
+
+        explicit Resampler(Filter filter = Filter::Lanczos3, size_t threads = 0);
+
+        Pixels resize(const Pixels& source, size_t width, size_t height) const;
+        // Levels are halved until 1x1 (or `levels` are produced); the source itself is not included.
+        std::vector<Pixels> mipChain(const Pixels& source, size_t levels = 0) const;
+
+    private:
+        class Plane {
+        public:
+            size_t width = 0;
+            size_t height = 0;
+            std::vector<float> values;
+
+            void reset(size_t planeWidth, size_t planeHeight);
+            float* row(size_t y);
+            const float* row(size_t y) const;
+        };
+
+        class Weights {
+        public:
+            Weights(Filter filter, size_t sourceSize, size_t destinationSize);
+
+            size_t taps() const;
+            size_t start(size_t index) const;
+            const float* get(size_t index) const;
+
+        private:
+            size_t taps_;
+            std::vector<size_t> starts;
+            std::vector<float> values;
+        };
+
+        Filter filter_;
+        size_t threads_;
+
+        void load(const Pixels& source, Plane& plane) const;
+        void store(const Plane& plane, Pixels& destination) const;
+        void resample(const Plane& source, Plane& intermediate, Plane& destination,
+                      size_t width, size_t height) const;
+        void horizontal(const Plane& source, Plane& destination, const Weights& weights) const;
+        void vertical(const Plane& source, Plane& destination, const Weights& weights) const;
+        void parallel(size_t count, size_t cost, const std::function<void(size_t, size_t)>& function) const;
+    };
+}
@@ -0,0 +1,938 @@
+#include "Scene.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+using namespace sglib;
+
+namespace {
+    const char signature[] = {'S', 'G', 'S', 'C'};
+    const uint8_t version = 1;
+    // Guards against allocating whatever a corrupt count asks for.
+    const uint32_t maximumCount = 1u << 26;
+    // Glyphs scaled further would be taller than any canvas worth rendering.
+    const uint32_t maximumScale = 4096;
+
+    const char* const opNames[] = {"fill", "flood-fill", "line", "ellipse", "rectangle", "polygon", "path",
+                                   "filled-ellipse", "filled-rectangle", "filled-polygon", "filled-path",
+                                   "text", "antialias", "clip", "unclip"};
+    const char* const directionNames[] = {"left-to-right", "right-to-left", "up-to-bottom", "bottom-to-up"};
+    const char* const capNames[] = {"butt", "square", "round"};
+    const char* const ruleNames[] = {"even-odd", "non-zero"};
+
+    template<size_t size>
+    int find(const char* const (&names)[size], const std::string& word) {
+        for (size_t i = 0; i < size; i++) {
+            if (word == names[i]) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    // How many coordinates follow each path verb.
+    size_t operands(char verb) {
+        switch (verb) {
+            case 'M':
+            case 'L':
+                return 2;
+            case 'Q':
+                return 4;
+            case 'C':
+                return 6;
+            case 'Z':
+                return 0;
+            default:
+                throw std::runtime_error(std::string("unknown path verb '") + verb + "'");
+        }
+    }
+
+    class Token {
+    public:
+        std::string text;
+        bool quoted;
+    };
+
+    // The tokens of one line of the text form, with the helpers that parse them.
+    class Reader {
+    public:
+        Reader(const std::string& line, size_t number) : lineNumber(number) {
+            size_t i = 0;
+            while (i < line.size()) {
+                if (std::isspace(static_cast<unsigned char>(line[i]))) {
+                    i++;
+                } else if (line[i] == '"') {
+                    std::string text;
+                    for (i++; i < line.size() && line[i] != '"'; i++) {
+                        if (line[i] == '\\' && i + 1 < line.size()) {
+                            i++;
+                        }
+                        text += line[i];
+                    }
+                    if (i == line.size()) {
+                        fail("unterminated string");
+                    }
+                    tokens.push_back({text, true});
+                    i++;
+                } else {
+                    const size_t start = i;
+                    while (i < line.size() && !std::isspace(static_cast<unsigned char>(line[i]))) {
+                        i++;
+                    }
+                    tokens.push_back({line.substr(start, i - start), false});
+                }
+            }
+        }
+
+        bool done() const {
+            return next == tokens.size();
+        }
+
+        bool peek(const char* word) const {
+            return !done() && !tokens[next].quoted && tokens[next].text == word;
+        }
+
+        const std::string& word() {
+            if (done() || tokens[next].quoted) {
+                fail("expected a word");
+            }
+            return tokens[next++].text;
+        }
+
+        float number() {
+            const std::string& text = word();
+            float result = 0.0f;
+            const auto parsed = std::from_chars(text.data(), text.data() + text.size(), result);
+            if (parsed.ec != std::errc() || parsed.ptr != text.data() + text.size()) {
+                fail("expected a number, got '" + text + "'");
+            }
+            return result;
+        }
+
+        uint32_t integer() {
+            const std::string& text = word();
+            uint32_t result = 0;
+            const auto parsed = std::from_chars(text.data(), text.data() + text.size(), result);
+            if (parsed.ec != std::errc() || parsed.ptr != text.data() + text.size()) {
+                fail("expected a whole number, got '" + text + "'");
+            }
+            return result;
+        }
+
+        template<size_t size>
+        int choice(const char* const (&names)[size], const char* what) {
+            const std::string& text = word();
+            const int index = find(names, text);
+            if (index < 0) {
+                fail(std::string("unknown ") + what + " '" + text + "'");
+            }
+            return index;
+        }
+
+        Color color() {
+            const std::string& text = word();
+            const Color* const named[] = {&Color::white, &Color::black, &Color::red, &Color::blue,
+                                          &Color::green, &Color::yellow};
+            const char* const names[] = {"white", "black", "red", "blue", "green", "yellow"};
+            const int index = find(names, text);
+            if (index >= 0) {
+                return *named[index];
+            }
+            const bool hex = text.find_first_not_of("0123456789abcdefABCDEF", 1) == std::string::npos;
+            if (text[0] != '#' || !hex || (text.size() != 7 && text.size() != 9)) {
+                fail("expected a color, got '" + text + "'");
+            }
+            const uint8_t alpha = text.size() == 9 ? static_cast<uint8_t>(std::stoul(text.substr(7), nullptr, 16)) : 255;
+            return Color(text.substr(0, 7), alpha);
+        }
+
+        // A color, or `gradient <direction> <color>...` with at least two stops.
+        void paint(Scene::Command& command) {
+            if (!peek("gradient")) {
+                command.colors.push_back(color());
+                return;
+            }
+            next++;
+            command.gradient = true;
+            command.direction = static_cast<LinearGradient::Type>(choice(directionNames, "gradient direction"));
+            while (!done() && !tokens[next].quoted && startsColor(tokens[next].text)) {
+                command.colors.push_back(color());
+            }
+            if (command.colors.size() < 2) {
+                fail("a gradient needs at least two colors");
+            }
+        }
+
+        void options(Scene::Command& command) {
+            while (true) {
+                if (peek("width")) {
+                    next++;
+                    command.width = number();
+                } else if (peek("cap")) {
+                    next++;
+                    command.cap = static_cast<Stroke::Cap>(choice(capNames, "cap"));
+                } else if (peek("rule")) {
+                    next++;
+                    command.rule = static_cast<Rasterizer::FillRule>(choice(ruleNames, "fill rule"));
+                } else if (peek("scale")) {
+                    next++;
+                    command.value = integer();
+                    if (command.value > maximumScale) {
+                        fail("text scale above " + std::to_string(maximumScale));
+                    }
+                } else if (peek("tolerance")) {
+                    next++;
+                    command.value = integer();
+                } else if (peek("transform")) {
+                    next++;
+                    command.transformed = true;
+                    float* fields[] = {&command.transform.xx, &command.transform.yx, &command.transform.xy,
+                                       &command.transform.yy, &command.transform.tx, &command.transform.ty};
+                    for (float* field : fields) {
+                        *field = number();
+                    }
+                } else {
+                    return;
+                }
+            }
+        }
+
+        void points(Scene::Command& command) {
+            expect("points");
+            while (!done()) {
+                command.numbers.push_back(number());
+            }
+            if (command.numbers.size() < 4 || command.numbers.size() % 2 != 0) {
+                fail("expected at least two x y pairs");
+            }
+        }
+
+        void path(Scene::Command& command) {
+            expect("data");
+            while (!done()) {
+                const std::string& verb = word();
+                if (verb.size() != 1) {
+                    fail("expected a path verb, got '" + verb + "'");
+                }
+                if (command.verbs.empty() && verb[0] != 'M') {
+                    fail("a path starts with M");
+                }
+                size_t count = 0;
+                try {
+                    count = operands(verb[0]);
+                } catch (const std::runtime_error& error) {
+                    fail(error.what());
+                }
+                command.verbs += verb[0];
+                for (size_t i = 0; i < count; i++) {
+                    command.numbers.push_back(number());
+                }
+            }
+            if (command.verbs.empty()) {
+                fail("empty path");
+            }
+        }
+
+        std::string quoted() {
+            if (done() || !tokens[next].quoted) {
+                fail("expected a quoted string");
+            }
+            return tokens[next++].text;
+        }
+
+        void expect(const char* word) {
+            if (!peek(word)) {
+                fail(std::string("expected '") + word + "'");
+            }
+            next++;
+        }
+
+        void finish() const {
+            if (!done()) {
+                fail("unexpected '" + tokens[next].text + "'");
+            }
+        }
+
+        [[noreturn]] void fail(const std::string& message) const {
+            throw std::runtime_error("line " + std::to_string(lineNumber) + ": " + message);
+        }
+
+    private:
+        std::vector<Token> tokens;
+        size_t next = 0;
+        size_t lineNumber;
+
+        static bool startsColor(const std::string& text) {
+            const char* const names[] = {"white", "black", "red", "blue", "green", "yellow"};
+            return text[0] == '#' || find(names, text) >= 0;
+        }
+    };
+
+    std::string format(float value) {
+        char buffer[32];
+        const auto written = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        return std::string(buffer, written.ptr);
+    }
+
+    std::string format(const Color& color) {
+        std::string result = color.getHex();
+        if (color.a() != 255) {
+            const char digits[] = "0123456789abcdef";
+            result += digits[color.a() >> 4];
+            result += digits[color.a() & 15];
+        }
+        return result;
+    }
+
+    // Flags of a command in the binary form, saying which optional fields follow.
+    enum : uint8_t {
+        Gradient = 1,
+        Transformed = 2,
+        Stroked = 4,
+        Ruled = 8
+    };
+
+    template<typename T>
+    void put(std::ostream& out, const T& value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    // Seven bits per byte, low bits first, with the top bit set on all but the last byte.
+    void putCount(std::ostream& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.put(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.put(static_cast<char>(value));
+    }
+
+    // An op, its flags and five counts of one byte each.
+    const size_t minimumCommand = 7;
+
+    // Reads the binary form straight out of memory.
+    class Cursor {
+    public:
+        Cursor(const std::string& data, size_t offset) : data(data), offset(offset) { }
+
+        template<typename T>
+        T get() {
+            T value;
+            take(&value, sizeof(value));
+            return value;
+        }
+
+        uint32_t count() {
+            uint64_t value = 0;
+            for (unsigned shift = 0;; shift += 7) {
+                const auto byte = get<uint8_t>();
+                value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                if (value > maximumCount || shift > 28) {
+                    throw std::runtime_error("corrupt scene");
+                }
+                if ((byte & 0x80) == 0) {
+                    return static_cast<uint32_t>(value);
+                }
+            }
+        }
+
+        // A count of items taking at least `size` bytes each, refused before anything is
+        // allocated for them if the rest of the data is too short to hold them.
+        uint32_t count(size_t size) {
+            const uint32_t value = count();
+            if (value > (data.size() - offset) / size) {
+                throw std::runtime_error("truncated scene");
+            }
+            return value;
+        }
+
+        void take(void* target, size_t size) {
+            if (data.size() - offset < size) {
+                throw std::runtime_error("truncated scene");
+            }
+            // Empty vectors may have no storage to copy into.
+            if (size == 0) {
+                return;
+            }
+            std::memcpy(target, data.data() + offset, size);
+            offset += size;
+        }
+
+    private:
+        const std::string& data;
+        size_t offset;
+    };
+
+    template<typename Enum, size_t size>
+    Enum checked(uint8_t value, const char* const (&)[size]) {
+        if (value >= size) {
+            throw std::runtime_error("corrupt scene");
+        }
+        return static_cast<Enum>(value);
+    }
+
+    Array<Point<float>> points(const std::vector<float>& numbers) {
+        Array<Point<float>> result(numbers.size() / 2);
+        for (size_t i = 0; i < result.size(); i++) {
+            result[i] = Point<float>(numbers[2 * i], numbers[2 * i + 1]);
+        }
+        return result;
+    }
+
+    // Whether draw() finds every number and color it reads.
+    bool valid(const Scene::Command& command) {
+        using Op = Scene::Op;
+        size_t numbers = 0;
+        switch (command.op) {
+            case Op::Fill:
+            case Op::Antialias:
+            case Op::Unclip:
+                break;
+            case Op::FloodFill:
+                numbers = 2;
+                break;
+            case Op::Text:
+                numbers = 2;
+                if (command.value == 0 || command.value > maximumScale) {
+                    return false;
+                }
+                break;
+            case Op::Polygon:
+            case Op::FilledPolygon:
+                numbers = 4;
+                if (command.numbers.size() % 2 != 0) {
+                    return false;
+                }
+                break;
+            case Op::Path:
+            case Op::FilledPath:
+                if (command.verbs.empty()) {
+                    return false;
+                }
+                for (char verb : command.verbs) {
+                    if (verb != 'M' && verb != 'L' && verb != 'Q' && verb != 'C' && verb != 'Z') {
+                        return false;
+                    }
+                    numbers += operands(verb);
+                }
+                break;
+            default:
+                numbers = 4;
+                break;
+        }
+        const bool colorless = command.op == Op::Antialias || command.op == Op::Clip || command.op == Op::Unclip;
+        return command.numbers.size() >= numbers && (colorless || !command.colors.empty());
+    }
+
+    LinearGradient gradient(const std::vector<Color>& colors) {
+        Array<Color> stops(colors.size());
+        for (size_t i = 0; i < colors.size(); i++) {
+            stops[i] = colors[i];
+        }
+        return LinearGradient(stops);
+    }
+}
+
+Scene Scene::read(std::istream& in) {
+    return read(std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>()));
+}
+
+Scene Scene::read(const std::string& data) {
+    if (data.size() >= sizeof(signature) && std::memcmp(data.data(), signature, sizeof(signature)) == 0) {
+        return decode(data);
+    }
+    return parse(data);
+}
+
+Scene Scene::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open " + path);
+    }
+    return read(file);
+}
+
+void Scene::write(std::ostream& out, Format format) const {
+    if (format == Format::Binary) {
+        writeBinary(out);
+    } else {
+        writeText(out);
+    }
+}
+
+void Scene::save(const std::string& path, Format format) const {
+    std::ofstream file(path, format == Format::Binary ? std::ios::binary : std::ios::out);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to create " + path);
+    }
+    write(file, format);
+    if (!file) {
+        throw std::runtime_error("failed to write " + path);
+    }
+}
+
+Scene Scene::parse(const std::string& data) {
+    Scene scene;
+    bool started = false;
+    size_t lineNumber = 0;
+    for (size_t start = 0; start < data.size();) {
+        size_t end = data.find('\n', start);
+        if (end == std::string::npos) {
+            end = data.size();
+        }
+        const std::string line = data.substr(start, end - start);
+        start = end + 1;
+        lineNumber++;
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        Reader reader(line, lineNumber);
+        const std::string& name = reader.word();
+        if (!started) {
+            if (name != "scene") {
+                reader.fail("a scene starts with 'scene <width> <height>'");
+            }
+            scene.sceneWidth = reader.integer();
+            scene.sceneHeight = reader.integer();
+            if (!reader.done()) {
+                scene.backgroundColor = reader.color();
+            }
+            reader.finish();
+            started = true;
+            continue;
+        }
+        const int op = find(opNames, name);
+        if (op < 0) {
+            reader.fail("unknown command '" + name + "'");
+        }
+        Command command;
+        command.op = static_cast<Op>(op);
+        switch (command.op) {
+            case Op::Fill:
+                reader.paint(command);
+                break;
+            case Op::FloodFill:
+                command.numbers = {reader.number(), reader.number()};
+                command.colors.push_back(reader.color());
+                reader.options(command);
+                break;
+            case Op::Line:
+            case Op::Ellipse:
+            case Op::Rectangle:
+                command.numbers = {reader.number(), reader.number(), reader.number(), reader.number()};
+                command.colors.push_back(reader.color());
+                reader.options(command);
+                break;
+            case Op::Polygon:
+                command.colors.push_back(reader.color());
+                reader.options(command);
+                reader.points(command);
+                break;
+            case Op::Path:
+                command.colors.push_back(reader.color());
+                reader.options(command);
+                reader.path(command);
+                break;
+            case Op::FilledEllipse:
+            case Op::FilledRectangle:
+                command.numbers = {reader.number(), reader.number(), reader.number(), reader.number()};
+                reader.paint(command);
+                reader.options(command);
+                break;
+            case Op::FilledPolygon:
+                reader.paint(command);
+                reader.options(command);
+                reader.points(command);
+                break;
+            case Op::FilledPath:
+                reader.paint(command);
+                reader.options(command);
+                reader.path(command);
+                break;
+            case Op::Text:
+                command.numbers = {reader.number(), reader.number()};
+                command.colors.push_back(reader.color());
+                command.value = 1;
+                reader.options(command);
+                command.text = reader.quoted();
+                break;
+            case Op::Antialias: {
+                const std::string& state = reader.word();
+                if (state != "on" && state != "off") {
+                    reader.fail("expected on or off");
+                }
+                command.value = state == "on" ? 1 : 0;
+                break;
+            }
+            case Op::Clip:
+                command.numbers = {reader.number(), reader.number(), reader.number(), reader.number()};
+                break;
+            case Op::Unclip:
+                break;
+        }
+        reader.finish();
+        scene.sceneCommands.push_back(std::move(command));
+    }
+    if (!started) {
+        throw std::runtime_error("empty scene");
+    }
+    return scene;
+}
+
+void Scene::writeText(std::ostream& out) const {
+    out << "scene " << sceneWidth << ' ' << sceneHeight << ' ' << format(backgroundColor) << '\n';
+    for (const auto& command : sceneCommands) {
+        out << opNames[static_cast<size_t>(command.op)];
+        auto paint = [&] {
+            if (command.gradient) {
+                out << " gradient " << directionNames[static_cast<size_t>(command.direction)];
+            }
+            for (const auto& color : command.colors) {
+                out << ' ' << format(color);
+            }
+        };
+        auto numbers = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                out << ' ' << format(command.numbers[i]);
+            }
+        };
+        auto stroke = [&] {
+            out << " width " << format(command.width) << " cap " << capNames[static_cast<size_t>(command.cap)];
+        };
+        auto rule = [&] {
+            out << " rule " << ruleNames[static_cast<size_t>(command.rule)];
+        };
+        switch (command.op) {
+            case Op::Fill:
+                paint();
+                break;
+            case Op::FloodFill:
+                numbers(0, 2);
+                paint();
+                out << " tolerance " << command.value;
+                break;
+            case Op::Line:
+            case Op::Ellipse:
+            case Op::Rectangle:
+                numbers(0, 4);
+                paint();
+                stroke();
+                break;
+            case Op::Polygon:
+                paint();
+                stroke();
+                out << " points";
+                numbers(0, command.numbers.size());
+                break;
+            case Op::Path:
+            case Op::FilledPath: {
+                paint();
+                if (command.op == Op::Path) {
+                    stroke();
+                } else {
+                    rule();
+                }
+                out << " data";
+                size_t next = 0;
+                for (char verb : command.verbs) {
+                    out << ' ' << verb;
+                    numbers(next, next + operands(verb));
+                    next += operands(verb);
+                }
+                break;
+            }
+            case Op::FilledEllipse:
+            case Op::FilledRectangle:
+                numbers(0, 4);
+                paint();
+                if (command.transformed) {
+                    const Transform2D& t = command.transform;
+                    out << " transform " << format(t.xx) << ' ' << format(t.yx) << ' ' << format(t.xy) << ' '
+                        << format(t.yy) << ' ' << format(t.tx) << ' ' << format(t.ty);
+                }
+                break;
+            case Op::FilledPolygon:
+                paint();
+                rule();
+                out << " points";
+                numbers(0, command.numbers.size());
+                break;
+            case Op::Text: {
+                numbers(0, 2);
+                paint();
+                out << " scale " << command.value << " \"";
+                for (char c : command.text) {
+                    if (c == '"' || c == '\\') {
+                        out << '\\';
+                    }
+                    out << c;
+                }
+                out << '"';
+                break;
+            }
+            case Op::Antialias:
+                out << (command.value != 0 ? " on" : " off");
+                break;
+            case Op::Clip:
+                numbers(0, 4);
+                break;
+            case Op::Unclip:
+                break;
+        }
+        out << '\n';
+    }
+}
+
+void Scene::writeBinary(std::ostream& out) const {
+    out.write(signature, sizeof(signature));
+    put(out, version);
+    putCount(out, sceneWidth);
+    putCount(out, sceneHeight);
+    put(out, backgroundColor);
+    putCount(out, sceneCommands.size());
+    const Command defaults;
+    for (const auto& command : sceneCommands) {
+        const bool stroked = command.width != defaults.width || command.cap != defaults.cap;
+        put(out, static_cast<uint8_t>(command.op));
+        put(out, static_cast<uint8_t>((command.gradient ? Gradient : 0) | (command.transformed ? Transformed : 0) |
+                                      (stroked ? Stroked : 0) | (command.rule != defaults.rule ? Ruled : 0)));
+        if (command.gradient) {
+            put(out, static_cast<uint8_t>(command.direction));
+        }
+        if (stroked) {
+            put(out, command.width);
+            put(out, static_cast<uint8_t>(command.cap));
+        }
+        if (command.rule != defaults.rule) {
+            put(out, static_cast<uint8_t>(command.rule));
+        }
+        if (command.transformed) {
+            put(out, command.transform);
+        }
+        putCount(out, command.value);
+        putCount(out, command.numbers.size());
+        out.write(reinterpret_cast<const char*>(command.numbers.data()),
+                  static_cast<std::streamsize>(command.numbers.size() * sizeof(float)));
+        putCount(out, command.colors.size());
+        out.write(reinterpret_cast<const char*>(command.colors.data()),
+                  static_cast<std::streamsize>(command.colors.size() * sizeof(Color)));
+        putCount(out, command.verbs.size());
+        out.write(command.verbs.data(), static_cast<std::streamsize>(command.verbs.size()));
+        putCount(out, command.text.size());
+        out.write(command.text.data(), static_cast<std::streamsize>(command.text.size()));
+    }
+}
+
+Scene Scene::decode(const std::string& data) {
+    Cursor cursor(data, sizeof(signature));
+    if (cursor.get<uint8_t>() != version) {
+        throw std::runtime_error("unsupported scene version");
+    }
+    Scene scene;
+    scene.sceneWidth = cursor.count();
+    scene.sceneHeight = cursor.count();
+    scene.backgroundColor = cursor.get<Color>();
+    scene.sceneCommands.resize(cursor.count(minimumCommand));
+    for (auto& command : scene.sceneCommands) {
+        command.op = checked<Op>(cursor.get<uint8_t>(), opNames);
+        const auto flags = cursor.get<uint8_t>();
+        command.gradient = (flags & Gradient) != 0;
+        command.transformed = (flags & Transformed) != 0;
+        if (command.gradient) {
+            command.direction = checked<LinearGradient::Type>(cursor.get<uint8_t>(), directionNames);
+        }
+        if ((flags & Stroked) != 0) {
+            command.width = cursor.get<float>();
+            command.cap = checked<Stroke::Cap>(cursor.get<uint8_t>(), capNames);
+        }
+        if ((flags & Ruled) != 0) {
+            command.rule = checked<Rasterizer::FillRule>(cursor.get<uint8_t>(), ruleNames);
+        }
+        if (command.transformed) {
+            command.transform = cursor.get<Transform2D>();
+        }
+        command.value = cursor.count();
+        command.numbers.resize(cursor.count(sizeof(float)));
+        cursor.take(command.numbers.data(), command.numbers.size() * sizeof(float));
+        command.colors.resize(cursor.count(sizeof(Color)));
+        cursor.take(command.colors.data(), command.colors.size() * sizeof(Color));
+        command.verbs.resize(cursor.count(1));
+        cursor.take(&command.verbs[0], command.verbs.size());
+        command.text.resize(cursor.count(1));
+        cursor.take(&command.text[0], command.text.size());
+        if (!valid(command)) {
+            throw std::runtime_error("corrupt scene");
+        }
+    }
+    return scene;
+}
+
+void Scene::render(Canvas& canvas) const {
+    if (canvas.width() != sceneWidth || canvas.height() != sceneHeight) {
+        throw std::invalid_argument("canvas size differs from the scene");
+    }
+    if (canvas.get().clipped()) {
+        throw std::invalid_argument("canvas has a clip");
+    }
+    canvas.setAntialiasing(false);
+    canvas.clear(backgroundColor);
+    size_t clips = 0;
+    try {
+        for (const auto& command : sceneCommands) {
+            if (command.op == Op::Clip) {
+                clips++;
+            } else if (command.op == Op::Unclip) {
+                if (clips == 0) {
+                    throw std::runtime_error("unclip without a clip");
+                }
+                clips--;
+            }
+            draw(canvas, command);
+        }
+    } catch (...) {
+        for (; clips > 0; clips--) {
+            canvas.popClip();
+        }
+        throw;
+    }
+    for (; clips > 0; clips--) {
+        canvas.popClip();
+    }
+}
+
+Canvas Scene::render(Pixels::Storage storage) const {
+    Canvas canvas(sceneWidth, sceneHeight, backgroundColor, storage);
+    render(canvas);
+    return canvas;
+}
+
+void Scene::draw(Canvas& canvas, const Command& command) const {
+    const std::vector<float>& n = command.numbers;
+    const Stroke stroke(command.width, command.cap);
+    switch (command.op) {
+        case Op::Fill:
+            if (command.gradient) {
+                canvas.fill(gradient(command.colors), command.direction);
+            } else {
+                canvas.fill(command.colors[0]);
+            }
+            break;
+        case Op::FloodFill:
+            canvas.floodFill({n[0], n[1]}, command.colors[0], static_cast<uint8_t>(std::min(command.value, 255u)));
+            break;
+        case Op::Line:
+            canvas.addLine({n[0], n[1]}, {n[2], n[3]}, command.colors[0], stroke);
+            break;
+        case Op::Ellipse:
+            canvas.addEllipse({n[0], n[1]}, {n[2], n[3]}, command.colors[0], stroke);
+            break;
+        case Op::Rectangle:
+            canvas.addRectangle({n[0], n[1]}, {n[2], n[3]}, command.colors[0], stroke);
+            break;
+        case Op::Polygon:
+            canvas.addPolygon(points(n), command.colors[0], stroke);
+            break;
+        case Op::FilledEllipse:
+        case Op::FilledRectangle: {
+            const bool ellipse = command.op == Op::FilledEllipse;
+            const Point<float> lower(n[0], n[1]), upper(n[2], n[3]);
+            if (command.gradient) {
+                const LinearGradient fill = gradient(command.colors);
+                if (command.transformed) {
+                    ellipse ? canvas.addFilledEllipse(lower, upper, fill, command.direction, command.transform)
+                            : canvas.addFilledRectangle(lower, upper, fill, command.direction, command.transform);
+                } else {
+                    ellipse ? canvas.addFilledEllipse(lower, upper, fill, command.direction)
+                            : canvas.addFilledRectangle(lower, upper, fill, command.direction);
+                }
+            } else if (command.transformed) {
+                ellipse ? canvas.addFilledEllipse(lower, upper, command.colors[0], command.transform)
+                        : canvas.addFilledRectangle(lower, upper, command.colors[0], command.transform);
+            } else {
+                ellipse ? canvas.addFilledEllipse(lower, upper, command.colors[0])
+                        : canvas.addFilledRectangle(lower, upper, command.colors[0]);
+            }
+            break;
+        }
+        case Op::FilledPolygon:
+            if (command.gradient) {
+                canvas.addFilledPolygon(points(n), gradient(command.colors), command.direction, command.rule);
+            } else {
+                canvas.addFilledPolygon(points(n), command.colors[0], command.rule);
+            }
+            break;
+        case Op::Path:
+        case Op::FilledPath: {
+            sglib::Path path;
+            size_t i = 0;
+            for (char verb : command.verbs) {
+                switch (verb) {
+                    case 'M':
+                        path.moveTo({n[i], n[i + 1]});
+                        break;
+                    case 'L':
+                        path.lineTo({n[i], n[i + 1]});
+                        break;
+                    case 'Q':
+                        path.quadTo({n[i], n[i + 1]}, {n[i + 2], n[i + 3]});
+                        break;
+                    case 'C':
+                        path.cubicTo({n[i], n[i + 1]}, {n[i + 2], n[i + 3]}, {n[i + 4], n[i + 5]});
+                        break;
+                    default:
+                        path.close();
+                        break;
+                }
+                i += operands(verb);
+            }
+            if (command.op == Op::Path) {
+                canvas.addPath(path, command.colors[0], stroke);
+            } else if (command.gradient) {
+                canvas.addFilledPath(path, gradient(command.colors), command.direction, command.rule);
+            } else {
+                canvas.addFilledPath(path, command.colors[0], command.rule);
+            }
+            break;
+        }
+        case Op::Text:
+            canvas.addText({n[0], n[1]}, command.text, command.colors[0], Font::standard(), command.value);
+            break;
+        case Op::Antialias:
+            canvas.setAntialiasing(command.value != 0);
+            break;
+        case Op::Clip:
+            canvas.pushClip({n[0], n[1]}, {n[2], n[3]});
+            break;
+        case Op::Unclip:
+            canvas.popClip();
+            break;
+    }
+}
+
+size_t Scene::width() const {
+    return sceneWidth;
+}
+
+size_t Scene::height() const {
+    return sceneHeight;
+}
+
+const Color& Scene::background() const {
+    return backgroundColor;
+}
+
+const std::vector<Scene::Command>& Scene::commands() const {
+    return sceneCommands;
+}
+
+Scene& Scene::add(const Command& command) {
+    if (!valid(command)) {
+        throw std::invalid_argument("incomplete scene command");
+    }
+    sceneCommands.push_back(command);
+    return *this;
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include "Canvas.h"
+#include "Color.h"
+#include "LinearGradient.h"
+#include "Rasterizer.h"
+#include "Stroke.h"
+#include "Transform2D.h"
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace sglib {
+    // A list of drawing commands that can be stored and rendered without writing any code. The
+    // text form has one command per line, with the canvas size and background on the first line:
+    //
+    //     scene 1920 1080 #4295f5
+    //     # lines starting with # are comments
+    //     antialias on
+    //     fill gradient up-to-bottom #461061 #31096e #110326
+    //     filled-rectangle 0 0 1920 400 #17a607
+    //     filled-ellipse 850 300 1000 600 #63d656c0 transform 1 0 0.5 1 0 0
+    //     line 0 0 500 500 blue width 3 cap round
+    //     filled-polygon red rule even-odd points 10 10 200 10 100 150
+    //     path black width 2 data M 10 10 C 50 100 150 100 200 10 Z
+    //     text 20 20 black scale 2 "hello"
+    //
+    // Colors are #rrggbb, #rrggbbaa or one of the named Color constants. Wherever a filled
+    // shape takes a color, `gradient <direction> <color> <color>...` also works. The binary form
+    // stores the same commands without any parsing, for scenes that are rendered many times.
+    class Scene {
+    public:
+        enum class Format {
+            Text,
+            Binary
+        };
+
+        enum class Op : uint8_t {
+            Fill,
+            FloodFill,
+            Line,
+            Ellipse,
+            Rectangle,
+            Polygon,
+            Path,
+            FilledEllipse,
+            FilledRectangle,
+            FilledPolygon,
+            FilledPath,
+            Text,
+            Antialias,
+            Clip,
+            Unclip
+        };
+
+        class Command {
+        public:
+            Op op = Op::Fill;
+            // Corners for lines, ellipses, rectangles and clips, the seed of a flood fill, the
+            // position of text, x y pairs of polygons, or the coordinates of path verbs.
+            std::vector<float> numbers;
+            // One of M, L, Q, C and Z per path verb.
+            std::string verbs;
+            // One color, or the stops of a gradient.
+            std::vector<Color> colors;
+            bool gradient = false;
+            LinearGradient::Type direction = LinearGradient::Type::LeftToRight;
+            float width = 1.0f;
+            Stroke::Cap cap = Stroke::Cap::Butt;
+            Rasterizer::FillRule rule = Rasterizer::FillRule::NonZero;
+            bool transformed = false;
+            Transform2D transform;
+            // Text scale, flood fill tolerance, or 1 to turn antialiasing on.
+            uint32_t value = 0;
+            std::string text;
+        };
+
+        explicit Scene(size_t width = 0, size_t height = 0, const Color& background = Color::white) :
+                sceneWidth(width), sceneHeight(height), backgroundColor(background) { }
+
+        // Reads either form, telling them apart by the binary signature.
+        static Scene read(std::istream& in);
+        static Scene read(const std::string& data);
+        static Scene load(const std::string& path);
+        void write(std::ostream& out, Format format) const;
+        void save(const std::string& path, Format format) const;
+
+        // Clears `canvas`, which must have the scene's size and no clip, to the background and draws
+        // the scene into it. Contiguous canvases are cleared in place, so one can be reused for
+        // many scenes without reallocating.
+        void render(Canvas& canvas) const;
+        Canvas render(Pixels::Storage storage = Pixels::Storage::Tiled) const;
+
+        size_t width() const;
+        size_t height() const;
+        const Color& background() const;
+        const std::vector<Command>& commands() const;
+        // Throws std::invalid_argument when the command lacks the numbers or colors its op needs.
+        Scene& add(const Command& command);
+
+    private:
+        size_t sceneWidth, sceneHeight;
+        Color backgroundColor;
+        std::vector<Command> sceneCommands;
+
+        static Scene parse(const std::string& data);
+        static Scene decode(const std::string& data);
+        void writeText(std::ostream& out) const;
+        void writeBinary(std::ostream& out) const;
+        void draw(Canvas& canvas, const Command& command) const;
+    };
+}
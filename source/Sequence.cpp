@@ -0,0 +1,387 @@
+#include "Sequence.h"
+#include "Executor.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+using namespace sglib;
+
+namespace {
+    const char signature[] = {'S', 'G', 'D', 'S'};
+    const uint8_t version = 1;
+
+    template<typename T>
+    void put(std::ostream& out, const T& value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template<typename T>
+    bool take(std::istream& in, T& value) {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+
+    // Where the frame number goes in a bitmap name pattern: the %d or %0Nd conversion.
+    class Placeholder {
+    public:
+        size_t position = std::string::npos;
+        size_t length = 0;
+        int digits = 0;
+    };
+
+    Placeholder placeholder(const std::string& pattern) {
+        Placeholder result;
+        for (size_t i = pattern.find('%'); i != std::string::npos; i = pattern.find('%', i + 1)) {
+            size_t end = i + 1;
+            while (end < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[end]))) {
+                end++;
+            }
+            if (end == pattern.size() || pattern[end] != 'd' || (end > i + 1 && pattern[i + 1] != '0') ||
+                result.position != std::string::npos) {
+                throw std::invalid_argument("the pattern needs exactly one %d or %0Nd");
+            }
+            result.position = i;
+            result.length = end + 1 - i;
+            result.digits = end > i + 1 ? std::stoi(pattern.substr(i + 1, end - i - 1)) : 0;
+        }
+        if (result.position == std::string::npos) {
+            throw std::invalid_argument("the pattern needs exactly one %d or %0Nd");
+        }
+        return result;
+    }
+
+    std::string frameName(const std::string& pattern, size_t index) {
+        const Placeholder where = placeholder(pattern);
+        std::string number = std::to_string(index);
+        if (number.size() < static_cast<size_t>(where.digits)) {
+            number.insert(0, static_cast<size_t>(where.digits) - number.size(), '0');
+        }
+        return pattern.substr(0, where.position) + number + pattern.substr(where.position + where.length);
+    }
+
+    // Rows [y, y + rows) of a delta frame, with the pixels [x, x + columns) of each.
+    class Range {
+    public:
+        uint32_t y, rows, x, columns;
+    };
+}
+
+FrameSequence FrameSequence::bitmaps(size_t width, size_t height, const std::string& pattern,
+                                     const Color& background, const Options& options) {
+    placeholder(pattern);
+    return FrameSequence(width, height, pattern, background, options, false);
+}
+
+FrameSequence FrameSequence::delta(size_t width, size_t height, const std::string& path,
+                                   const Color& background, const Options& options) {
+    return FrameSequence(width, height, path, background, options, true);
+}
+
+FrameSequence::FrameSequence(size_t width, size_t height, const std::string& target, const Color& background,
+                             const Options& options, bool delta) :
+        backgroundColor(background), options(options), target(target), deltaStream(delta) {
+    if (options.buffers < (delta ? 3 : 2)) {
+        throw std::invalid_argument("too few frame buffers");
+    }
+    if (delta) {
+        stream.open(target, std::ios::out | std::ios::binary);
+        if (!stream.is_open()) {
+            throw std::invalid_argument("cannot create the file");
+        }
+        stream.write(signature, sizeof(signature));
+        put(stream, version);
+        put(stream, static_cast<uint32_t>(width));
+        put(stream, static_cast<uint32_t>(height));
+        written = sizeof(signature) + 1 + 2 * sizeof(uint32_t);
+    }
+    for (size_t i = 0; i < options.buffers; i++) {
+        canvases.emplace_back(width, height, background, Pixels::Storage::Contiguous);
+        cleared.push_back(false);
+        idle.push_back(i);
+    }
+    encoder = std::thread(&FrameSequence::encode, this);
+}
+
+FrameSequence::~FrameSequence() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    encoder.join();
+}
+
+Canvas& FrameSequence::begin() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (drawing != none) {
+        return canvases[drawing];
+    }
+    changed.wait(lock, [this] { return !idle.empty(); });
+    drawing = idle.front();
+    idle.pop_front();
+    const size_t source = last;
+    lock.unlock();
+
+    // The source frame may be encoded meanwhile, which only reads it too.
+    Canvas& canvas = canvases[drawing];
+    Pixels& pixels = canvas.get();
+    if (options.start == Start::Clear || source == none) {
+        // Rows left clean since the last clear still hold the background, so only the rows the
+        // frame drew into need clearing again.
+        if (!cleared[drawing]) {
+            canvas.clear(backgroundColor);
+            cleared[drawing] = true;
+        } else {
+            for (const auto& range : pixels.dirtyRanges()) {
+                pixels.setRange({0, range.first}, {pixels.width(), range.second}, backgroundColor);
+            }
+        }
+        pixels.checkpoint();
+    } else if (source != drawing) {
+        pixels.blit(canvases[source].get(), 0, 0);
+        cleared[drawing] = false;
+    }
+    return canvas;
+}
+
+void FrameSequence::commit() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (drawing == none) {
+            throw std::logic_error("commit() without begin()");
+        }
+        queued.push_back(drawing);
+        last = drawing;
+        drawing = none;
+        committed++;
+    }
+    changed.notify_all();
+}
+
+void FrameSequence::finish() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return queued.empty() && !encoding; });
+    if (deltaStream) {
+        stream.flush();
+    }
+    if (failure != nullptr) {
+        std::exception_ptr error = failure;
+        failure = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+size_t FrameSequence::frames() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return committed;
+}
+
+uint64_t FrameSequence::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return written;
+}
+
+void FrameSequence::encode() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return !queued.empty() || stopping; });
+        if (queued.empty()) {
+            return;
+        }
+        const size_t index = queued.front();
+        queued.pop_front();
+        encoding = true;
+        const size_t number = encoded;
+        const bool failed = failure != nullptr;
+        const size_t before = previous;
+        lock.unlock();
+
+        // After an error the frames are only recycled, so that begin() never waits forever.
+        uint64_t size = 0;
+        std::exception_ptr error;
+        if (!failed) {
+            try {
+                if (deltaStream) {
+                    const bool keyframe = before == none ||
+                                          (options.keyframeInterval != 0 && number % options.keyframeInterval == 0);
+                    size = writeDelta(canvases[index].get(), keyframe ? nullptr : &canvases[before].get());
+                } else {
+                    size = writeBitmap(canvases[index].get(), number);
+                }
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+
+        lock.lock();
+        written += size;
+        if (error != nullptr) {
+            failure = error;
+        }
+        encoded++;
+        encoding = false;
+        // A delta stream keeps the frame to compare the next one with.
+        if (deltaStream) {
+            if (previous != none) {
+                idle.push_back(previous);
+            }
+            previous = index;
+        } else {
+            idle.push_back(index);
+        }
+        lock.unlock();
+        changed.notify_all();
+    }
+}
+
+uint64_t FrameSequence::writeBitmap(const Pixels& frame, size_t index) {
+    const std::string name = frameName(target, index);
+    const uint8_t bytesPerPixel = options.type == Bitmap::Type::bit24 ? 3 : 4;
+    if (options.type == Bitmap::Type::bit24) {
+        Bitmap24(name).write(frame);
+    } else {
+        Bitmap32(name).write(frame);
+    }
+    // The 14-byte file header and 40-byte information header, then rows padded to 4 bytes.
+    const size_t stride = (frame.width() * bytesPerPixel + 3) / 4 * 4;
+    return 14 + 40 + stride * frame.height();
+}
+
+uint64_t FrameSequence::writeDelta(const Pixels& frame, const Pixels* before) {
+    const size_t width = frame.width();
+    const size_t height = frame.height();
+    // The columns [first, second) of each row that differ from the frame before; empty when the
+    // row did not change.
+    std::vector<std::pair<uint32_t, uint32_t>> changes(height, {0, static_cast<uint32_t>(width)});
+    if (before != nullptr) {
+        Executor::parallelFor(0, height, width * height, [&](size_t first, size_t last) {
+            for (size_t y = first; y < last; y++) {
+                const Color* now = frame.row(y);
+                const Color* then = before->row(y);
+                if (now == then || std::memcmp(now, then, width * sizeof(Color)) == 0) {
+                    changes[y] = {0, 0};
+                    continue;
+                }
+                size_t left = 0, right = width;
+                while (std::memcmp(&now[left], &then[left], sizeof(Color)) == 0) {
+                    left++;
+                }
+                while (std::memcmp(&now[right - 1], &then[right - 1], sizeof(Color)) == 0) {
+                    right--;
+                }
+                changes[y] = {static_cast<uint32_t>(left), static_cast<uint32_t>(right)};
+            }
+        });
+    }
+    // Neighbouring changed rows whose columns overlap are stored as one rectangle.
+    std::vector<Range> ranges;
+    for (size_t y = 0; y < height; y++) {
+        const auto& change = changes[y];
+        if (change.first == change.second) {
+            continue;
+        }
+        if (!ranges.empty()) {
+            Range& range = ranges.back();
+            if (range.y + range.rows == y && change.first <= range.x + range.columns && range.x <= change.second) {
+                const uint32_t left = std::min(range.x, change.first);
+                range.columns = std::max(range.x + range.columns, change.second) - left;
+                range.x = left;
+                range.rows++;
+                continue;
+            }
+        }
+        ranges.push_back({static_cast<uint32_t>(y), 1, change.first, change.second - change.first});
+    }
+
+    size_t size = 1 + sizeof(uint32_t);
+    for (const auto& range : ranges) {
+        size += sizeof(Range) + static_cast<size_t>(range.rows) * range.columns * sizeof(Color::Rgb);
+    }
+    buffer.resize(size);
+    uint8_t* out = buffer.data();
+    *out++ = before == nullptr ? 1 : 0;
+    const auto count = static_cast<uint32_t>(ranges.size());
+    std::memcpy(out, &count, sizeof(count));
+    out += sizeof(count);
+    for (const auto& range : ranges) {
+        std::memcpy(out, &range, sizeof(range));
+        out += sizeof(range);
+        for (uint32_t y = range.y; y < range.y + range.rows; y++) {
+            FormatConverter<Rgba32, Rgb24>::convert(frame.row(y) + range.x, reinterpret_cast<Color::Rgb*>(out),
+                                                    range.columns);
+            out += range.columns * sizeof(Color::Rgb);
+        }
+    }
+    stream.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+    if (!stream) {
+        throw std::runtime_error("failed to write " + target);
+    }
+    return size;
+}
+
+DeltaReader::DeltaReader(const std::string& path) : file(path, std::ios::in | std::ios::binary), frameIndex(0),
+                                                    started(false) {
+    if (!file.is_open()) {
+        throw std::invalid_argument("file not found");
+    }
+    char magic[sizeof(signature)];
+    uint8_t fileVersion = 0;
+    uint32_t width = 0, height = 0;
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, signature, sizeof(signature)) != 0 ||
+        !take(file, fileVersion) || !take(file, width) || !take(file, height)) {
+        throw std::runtime_error("not a delta stream");
+    }
+    if (fileVersion != version) {
+        throw std::runtime_error("unsupported delta stream version");
+    }
+    pixels = RgbPixels(width, height);
+}
+
+size_t DeltaReader::width() const {
+    return pixels.width();
+}
+
+size_t DeltaReader::height() const {
+    return pixels.height();
+}
+
+bool DeltaReader::next() {
+    uint8_t keyframe = 0;
+    if (!take(file, keyframe)) {
+        return false;
+    }
+    if (!started && keyframe == 0) {
+        throw std::runtime_error("corrupt delta stream");
+    }
+    uint32_t count = 0;
+    if (!take(file, count)) {
+        throw std::runtime_error("truncated delta stream");
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        Range range{};
+        if (!take(file, range)) {
+            throw std::runtime_error("truncated delta stream");
+        }
+        if (static_cast<uint64_t>(range.y) + range.rows > pixels.height() ||
+            static_cast<uint64_t>(range.x) + range.columns > pixels.width()) {
+            throw std::runtime_error("corrupt delta stream");
+        }
+        for (uint32_t y = range.y; y < range.y + range.rows; y++) {
+            if (!file.read(reinterpret_cast<char*>(pixels.row(y) + range.x),
+                           static_cast<std::streamsize>(range.columns * sizeof(Color::Rgb)))) {
+                throw std::runtime_error("truncated delta stream");
+            }
+        }
+    }
+    frameIndex = started ? frameIndex + 1 : 0;
+    started = true;
+    return true;
+}
+
+size_t DeltaReader::index() const {
+    return frameIndex;
+}
+
+const RgbPixels& DeltaReader::frame() const {
+    return pixels;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include "Bitmap.h"
+#include "Canvas.h"
+#include "Color.h"
+#include "Pixels.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sglib {
+    // Renders an animation frame by frame. Frames are drawn on the calling thread into a fixed
+    // pool of canvases, while a background thread encodes the frames committed before them:
+    //
+    //     FrameSequence sequence = FrameSequence::bitmaps(640, 480, "frames/%05d.bmp");
+    //     for (float x = 0; x < 590; x++) {
+    //         sequence.begin().addFilledEllipse({x, 100}, {x + 50, 150}, Color::red);
+    //         sequence.commit();
+    //     }
+    //     sequence.finish();
+    class FrameSequence {
+    public:
+        enum class Start {
+            // Every frame starts cleared to the background.
+            Clear,
+            // Every frame starts as a copy of the one committed before it.
+            Previous
+        };
+
+        class Options {
+        public:
+            Options() : buffers(3), start(Start::Clear), type(Bitmap::Type::bit24), keyframeInterval(0) { }
+
+            // Canvases in the pool; at least 2 for bitmaps and 3 for delta streams, which keep the
+            // previous frame to compare with. More let drawing run further ahead of encoding.
+            size_t buffers;
+            Start start;
+            Bitmap::Type type;
+            // In delta streams, every that many frames is stored whole; 0 stores only the first.
+            size_t keyframeInterval;
+        };
+
+        // One bitmap per frame, named by `pattern` with its single %d, or %0Nd, replaced by the
+        // frame number, e.g. "frames/%05d.bmp".
+        static FrameSequence bitmaps(size_t width, size_t height, const std::string& pattern,
+                                     const Color& background = Color::white, const Options& options = Options());
+        // All frames in one file holding, after the first, only the pixels that changed since the
+        // frame before; see DeltaReader. Stored as 24-bit color.
+        static FrameSequence delta(size_t width, size_t height, const std::string& path,
+                                   const Color& background = Color::white, const Options& options = Options());
+        FrameSequence(const FrameSequence& other) = delete;
+        FrameSequence& operator=(const FrameSequence& other) = delete;
+        // Waits for the queued frames, dropping any encoding error; call finish() to see it.
+        ~FrameSequence();
+
+        // The canvas to draw the next frame into. Blocks while every canvas is still queued or
+        // being encoded. Clips pushed while drawing must be popped before commit().
+        Canvas& begin();
+        // Queues the frame drawn since begin() for encoding and returns without waiting for it.
+        void commit();
+        // Waits until every committed frame is written, then rethrows the first encoding error.
+        void finish();
+        size_t frames() const;
+        // Bytes written so far, headers included.
+        uint64_t bytes() const;
+
+    private:
+        const static size_t none = static_cast<size_t>(-1);
+
+        Color backgroundColor;
+        Options options;
+        std::string target;
+        bool deltaStream;
+        std::ofstream stream;
+        std::vector<Canvas> canvases;
+        // Whether a canvas was cleared, and every row written since is marked dirty.
+        std::vector<bool> cleared;
+        // Canvases by index: free ones, and committed ones waiting for the encoder in order.
+        std::deque<size_t> idle, queued;
+        size_t drawing = none;
+        size_t last = none;
+        size_t previous = none;
+        size_t committed = 0;
+        size_t encoded = 0;
+        bool encoding = false;
+        bool stopping = false;
+        uint64_t written = 0;
+        std::exception_ptr failure;
+        std::vector<uint8_t> buffer;
+        mutable std::mutex mutex;
+        std::condition_variable changed;
+        std::thread encoder;
+
+        FrameSequence(size_t width, size_t height, const std::string& target, const Color& background,
+                      const Options& options, bool delta);
+        void encode();
+        uint64_t writeBitmap(const Pixels& frame, size_t index);
+        uint64_t writeDelta(const Pixels& frame, const Pixels* before);
+    };
+
+    // Plays back a stream written by FrameSequence::delta(), one full frame at a time.
+    class DeltaReader {
+    public:
+        explicit DeltaReader(const std::string& path);
+        size_t width() const;
+        size_t height() const;
+        // Moves to the next frame; false at the end of the stream.
+        bool next();
+        // The frame last moved to, counting from 0.
+        size_t index() const;
+        const RgbPixels& frame() const;
+
+    private:
+        std::ifstream file;
+        RgbPixels pixels;
+        size_t frameIndex;
+        bool started;
+    };
+}
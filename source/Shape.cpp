@@ -1,32 +1,132 @@
 #include "Shape.h"
+#include "Allocator.h"
 #include <stdexcept>
+#include <algorithm>
 #include <cmath>
+#include <functional>
+#include <memory>
 #include <random>
+#include <utility>
+#include <vector>
 
 using namespace sglib;
 
+namespace {
+    // Fills take their rasterizer from a per-thread pool and give it back cleared, so the edge
+    // and cell buffers grown by one fill are reused by the next.
+    class PooledRasterizer {
+    public:
+        PooledRasterizer() {
+            auto& idle = pool();
+            if (idle.empty()) {
+                rasterizer = std::make_unique<Rasterizer>();
+            } else {
+                rasterizer = std::move(idle.back());
+                idle.pop_back();
+            }
+        }
+        PooledRasterizer(const PooledRasterizer& other) = delete;
+        PooledRasterizer& operator=(const PooledRasterizer& other) = delete;
+        ~PooledRasterizer() {
+            rasterizer->clear();
+            try {
+                pool().push_back(std::move(rasterizer));
+            } catch (const std::bad_alloc&) { }
+        }
+
+        operator Rasterizer&() {
+            return *rasterizer;
+        }
+
+    private:
+        std::unique_ptr<Rasterizer> rasterizer;
+
+        static std::vector<std::unique_ptr<Rasterizer>>& pool() {
+            thread_local std::vector<std::unique_ptr<Rasterizer>> idle;
+            return idle;
+        }
+    };
+
+    // The columns i, as a closed range that is empty when first > second, for which
+    // ((i + 0.5) / radius - 1)^2 + b^2 <= 1: the test the aliased ellipse fills make for each
+    // pixel of a row. The closed form is only an estimate, settled by the test itself, so a
+    // span covers exactly the pixels the test accepts.
+    std::pair<int64_t, int64_t> ellipseRun(float radius, float b) {
+        auto inside = [radius, b](int64_t i) {
+            const float a = (static_cast<float>(i) + 0.5f) / radius - 1.0f;
+            return a * a + b * b <= 1.0f;
+        };
+        const float reach = sqrtf(std::max(0.0f, 1.0f - b * b));
+        auto first = static_cast<int64_t>(ceilf((1.0f - reach) * radius - 0.5f));
+        auto last = static_cast<int64_t>(floorf((1.0f + reach) * radius - 0.5f));
+        while (inside(first - 1)) {
+            first--;
+        }
+        while (first <= last && !inside(first)) {
+            first++;
+        }
+        while (inside(last + 1)) {
+            last++;
+        }
+        while (last >= first && !inside(last)) {
+            last--;
+        }
+        return {first, last};
+    }
+}
+
 Canvas& Line::draw() {
+    const auto scope = measure(RenderStats::Primitive::Line);
     drawLine(start_, finish_);
     return canvas_;
 }
 
+Canvas& Line::draw(const Stroke& stroke) {
+    const auto scope = measure(RenderStats::Primitive::Line);
+    if (stroke.thin()) {
+        return draw();
+    }
+    const Point<float> points[] = {start_, finish_};
+    strokeSpans(points, 2, false, stroke);
+    return canvas_;
+}
+
 Line Line::rotate(Point<float> origin, int angle) {
-    Point<float> startCorrected = start_;
-    Point<float> finishCorrected = finish_;
-    finishCorrected.rotate(origin, angle);
-    startCorrected.rotate(origin, angle);
-    return Line(canvas_, color_, startCorrected, finishCorrected);
+    return transform(Transform2D::rotate(static_cast<float>(angle), origin));
 }
 
 Line Line::mirror(const Line& other) {
-    Point<float> startCorrected = start_;
-    Point<float> finishCorrected = finish_;
-    startCorrected.mirror(other.start_, other.finish_);
-    finishCorrected.mirror(other.start_, other.finish_);
-    return Line(canvas_, color_, startCorrected, finishCorrected);
+    return transform(Transform2D::reflect(other.start_, other.finish_));
+}
+
+Line Line::transform(const Transform2D& transform) const {
+    return Line(canvas_, color_, transform.apply(start_), transform.apply(finish_));
+}
+
+bool Shape::clippedOut(const Point<float>& lowerBound, const Point<float>& upperBound) const {
+    Point<size_t> lower, upper;
+    canvas_.get().getClip(lower, upper);
+    // A pixel of slack covers rounding, pixel-center offsets and inclusive upper bounds.
+    return lower.x() >= upper.x() || lower.y() >= upper.y() ||
+           upperBound.x() + 1.0f < static_cast<float>(lower.x()) ||
+           upperBound.y() + 1.0f < static_cast<float>(lower.y()) ||
+           lowerBound.x() - 1.0f >= static_cast<float>(upper.x()) ||
+           lowerBound.y() - 1.0f >= static_cast<float>(upper.y());
+}
+
+RenderStats::Scope Shape::measure(RenderStats::Primitive primitive) const {
+    return RenderStats::Scope(canvas_.stats(), canvas_.get(), primitive);
 }
 
 void Shape::drawLine(Point<float> start, Point<float> end) {
+    if (clippedOut({std::min(start.x(), end.x()), std::min(start.y(), end.y())},
+                   {std::max(start.x(), end.x()), std::max(start.y(), end.y())})) {
+        return;
+    }
+    if (canvas_.antialiasing()) {
+        drawSmoothLine(start, end);
+        return;
+    }
     Pixels& pixels = canvas_.get();
     float k, b;
     if (start.x() != end.x()) {
@@ -55,8 +155,268 @@ void Shape::drawLine(Point<float> start, Point<float> end) {
     }
 }
 
+// Xiaolin Wu's line: each column along the major axis is shared by the two pixels nearest to the
+// line, weighted by distance, and the end columns are weighted by how far the line reaches into them.
+void Shape::drawSmoothLine(Point<float> start, Point<float> end) {
+    Pixels& pixels = canvas_.get();
+    const bool steep = std::abs(end.y() - start.y()) > std::abs(end.x() - start.x());
+    if (steep) {
+        start = {start.y(), start.x()};
+        end = {end.y(), end.x()};
+    }
+    if (start.x() > end.x()) {
+        std::swap(start, end);
+    }
+    const float dx = end.x() - start.x();
+    const float gradient = dx == 0.0f ? 0.0f : (end.y() - start.y()) / dx;
+    auto plot = [&](int64_t x, int64_t y, float coverage) {
+        const auto alpha = static_cast<uint8_t>(lroundf(std::min(coverage, 1.0f) * 255.0f));
+        if (steep) {
+            pixels.blend(y, x, color_, alpha);
+        } else {
+            pixels.blend(x, y, color_, alpha);
+        }
+    };
+    auto plotEnd = [&](const Point<float>& point, bool first) {
+        const float x = roundf(point.x());
+        const float y = point.y() + gradient * (x - point.x());
+        const float reach = point.x() + 0.5f - floorf(point.x() + 0.5f);
+        const float gap = first ? 1.0f - reach : reach;
+        const float row = floorf(y);
+        plot(static_cast<int64_t>(x), static_cast<int64_t>(row), (1.0f - (y - row)) * gap);
+        plot(static_cast<int64_t>(x), static_cast<int64_t>(row) + 1, (y - row) * gap);
+        return static_cast<int64_t>(x);
+    };
+    const int64_t first = plotEnd(start, true);
+    if (first == static_cast<int64_t>(roundf(end.x()))) {
+        return;
+    }
+    const int64_t last = plotEnd(end, false);
+    float y = start.y() + gradient * (static_cast<float>(first + 1) - start.x());
+    for (int64_t x = first + 1; x < last; x++) {
+        const float row = floorf(y);
+        plot(x, static_cast<int64_t>(row), 1.0f - (y - row));
+        plot(x, static_cast<int64_t>(row) + 1, y - row);
+        y += gradient;
+    }
+}
+
+void Shape::fillSpans(Rasterizer& rasterizer, Rasterizer::FillRule rule) {
+    Pixels& pixels = canvas_.get();
+    Point<float> lowerBound, upperBound;
+    if (!rasterizer.getBounds(lowerBound, upperBound) || clippedOut(lowerBound, upperBound)) {
+        return;
+    }
+    if (canvas_.antialiasing()) {
+        rasterizer.rasterizeCoverage(pixels.width(), pixels.height(), rule,
+                                     [&](int64_t y, int64_t x0, int64_t x1, uint8_t coverage) {
+            if (coverage == 255) {
+                pixels.setSpan(y, x0, x1, color_);
+            } else {
+                pixels.blendSpan(y, x0, x1, color_, coverage);
+            }
+        });
+        return;
+    }
+    rasterizer.rasterize(pixels.width(), pixels.height(), rule, [&](int64_t y, int64_t x0, int64_t x1) {
+        pixels.setSpan(y, x0, x1, color_);
+    });
+}
+
+void Shape::fillSpans(Rasterizer& rasterizer, Rasterizer::FillRule rule,
+                      const LinearGradient& gradient, LinearGradient::Type type,
+                      const Point<float>& lowerBound, const Point<float>& upperBound) {
+    Pixels& pixels = canvas_.get();
+    Point<float> lower, upper;
+    if (!rasterizer.getBounds(lower, upper) || clippedOut(lower, upper)) {
+        return;
+    }
+    const bool horizontal = type == LinearGradient::Type::LeftToRight ||
+                            type == LinearGradient::Type::RightToLeft;
+    const bool reversed = type == LinearGradient::Type::RightToLeft ||
+                          type == LinearGradient::Type::UpToBottom;
+    const auto origin = static_cast<int64_t>(floorf(horizontal ? lowerBound.x() : lowerBound.y()));
+    const auto length = static_cast<int64_t>(ceilf(horizontal ? upperBound.x() : upperBound.y())) - origin;
+    if (length <= 0) {
+        return;
+    }
+    Arena::Scope scratch;
+    Color* ramp = Arena::local().allocate<Color>(static_cast<size_t>(length));
+    gradient.ramp(ramp, static_cast<size_t>(length));
+    if (reversed) {
+        std::reverse(ramp, ramp + length);
+    }
+    auto paint = [&](int64_t y, int64_t x0, int64_t x1) {
+        if (horizontal) {
+            const int64_t left = std::max(x0, origin);
+            const int64_t right = std::min(x1, origin + length);
+            pixels.setSpan(y, x0, left, ramp[0]);
+            pixels.copySpan(y, left, right, ramp + (left - origin));
+            pixels.setSpan(y, right, x1, ramp[length - 1]);
+        } else {
+            const int64_t index = std::min(std::max<int64_t>(y - origin, 0), length - 1);
+            pixels.setSpan(y, x0, x1, ramp[index]);
+        }
+    };
+    // Both callbacks go by reference, so that wrapping them in std::function allocates nothing.
+    if (!canvas_.antialiasing()) {
+        rasterizer.rasterize(pixels.width(), pixels.height(), rule, std::ref(paint));
+        return;
+    }
+    auto blend = [&](int64_t y, int64_t x0, int64_t x1, uint8_t coverage) {
+        if (coverage == 255) {
+            paint(y, x0, x1);
+            return;
+        }
+        for (int64_t x = x0; x < x1; x++) {
+            const int64_t index = std::min(std::max<int64_t>((horizontal ? x : y) - origin, 0), length - 1);
+            pixels.blend(x, y, ramp[index], coverage);
+        }
+    };
+    rasterizer.rasterizeCoverage(pixels.width(), pixels.height(), rule, std::ref(blend));
+}
+
+void Shape::strokeSpans(const Point<float>* points, size_t count, bool closed, const Stroke& stroke) {
+    // Stroke centerlines pass through pixel centers, as the 1-pixel lines do.
+    Arena::Scope scratch;
+    Point<float>* centered = Arena::local().allocate<Point<float>>(count);
+    for (size_t i = 0; i < count; i++) {
+        centered[i] = {points[i].x() + 0.5f, points[i].y() + 0.5f};
+    }
+    PooledRasterizer pooled;
+    Rasterizer& rasterizer = pooled;
+    stroke.outline(centered, count, closed, rasterizer);
+    fillSpans(rasterizer, Rasterizer::FillRule::NonZero);
+}
+
+Transform2D Shape::pixelSpace(const Transform2D& transform) {
+    // Shape coordinates name pixels, while rasterization samples pixel centers at +0.5.
+    return Transform2D::translate(0.5f, 0.5f) * transform * Transform2D::translate(-0.5f, -0.5f);
+}
+
+void Shape::getTransformedBounds(const Transform2D& shape, bool round,
+                                 Point<float>& lowerBound, Point<float>& upperBound) {
+    if (round) {
+        const float width = sqrtf(shape.xx * shape.xx + shape.xy * shape.xy);
+        const float height = sqrtf(shape.yx * shape.yx + shape.yy * shape.yy);
+        lowerBound = {shape.tx - width, shape.ty - height};
+        upperBound = {shape.tx + width, shape.ty + height};
+        return;
+    }
+    lowerBound = {shape.tx + std::min(shape.xx, 0.0f) + std::min(shape.xy, 0.0f),
+                  shape.ty + std::min(shape.yx, 0.0f) + std::min(shape.yy, 0.0f)};
+    upperBound = {shape.tx + std::max(shape.xx, 0.0f) + std::max(shape.xy, 0.0f),
+                  shape.ty + std::max(shape.yx, 0.0f) + std::max(shape.yy, 0.0f)};
+}
+
+void Shape::addTransformed(const Transform2D& shape, bool round, Rasterizer& rasterizer) {
+    if (round) {
+        Stroke::addEllipse(shape, false, rasterizer);
+        return;
+    }
+    const Point<float> corners[] = {shape.apply({0.0f, 0.0f}), shape.apply({1.0f, 0.0f}),
+                                    shape.apply({1.0f, 1.0f}), shape.apply({0.0f, 1.0f})};
+    rasterizer.addContour(corners, 4);
+}
+
+// Every row is mapped back into the unit shape, where being inside is a linear (square) or
+// quadratic (disc) condition on x, so each row's span is solved for directly.
+void Shape::fillTransformed(const Transform2D& shape, bool round) {
+    Point<float> lowerBound, upperBound;
+    getTransformedBounds(shape, round, lowerBound, upperBound);
+    if (shape.determinant() == 0.0f || clippedOut(lowerBound, upperBound)) {
+        return;
+    }
+    if (canvas_.antialiasing()) {
+        PooledRasterizer pooled;
+        Rasterizer& rasterizer = pooled;
+        addTransformed(shape, round, rasterizer);
+        fillSpans(rasterizer, Rasterizer::FillRule::NonZero);
+        return;
+    }
+    Pixels& pixels = canvas_.get();
+    const Transform2D inverse = shape.inverse();
+    const auto firstRow = std::max<int64_t>(0, static_cast<int64_t>(ceilf(lowerBound.y() - 0.5f)));
+    const auto lastRow = std::min(static_cast<int64_t>(pixels.height()),
+                                  static_cast<int64_t>(ceilf(upperBound.y() - 0.5f)));
+    for (int64_t row = firstRow; row < lastRow; row++) {
+        const float y = static_cast<float>(row) + 0.5f;
+        const float u = inverse.xy * y + inverse.tx;
+        const float v = inverse.yy * y + inverse.ty;
+        float left = -std::numeric_limits<float>::infinity();
+        float right = std::numeric_limits<float>::infinity();
+        if (round) {
+            const float a = inverse.xx * inverse.xx + inverse.yx * inverse.yx;
+            const float b = 2.0f * (inverse.xx * u + inverse.yx * v);
+            const float c = u * u + v * v - 1.0f;
+            const float discriminant = b * b - 4.0f * a * c;
+            if (discriminant < 0.0f) {
+                continue;
+            }
+            left = (-b - sqrtf(discriminant)) / (2.0f * a);
+            right = (-b + sqrtf(discriminant)) / (2.0f * a);
+        } else {
+            for (const auto& [slope, offset] : {std::make_pair(inverse.xx, u), std::make_pair(inverse.yx, v)}) {
+                if (slope == 0.0f) {
+                    if (offset < 0.0f || offset > 1.0f) {
+                        right = left;
+                    }
+                    continue;
+                }
+                const float from = -offset / slope;
+                const float to = (1.0f - offset) / slope;
+                left = std::max(left, std::min(from, to));
+                right = std::min(right, std::max(from, to));
+            }
+            if (!(left < right)) {
+                continue;
+            }
+        }
+        pixels.setSpan(row, static_cast<int64_t>(std::max(ceilf(left - 0.5f), -1.0f)),
+                       static_cast<int64_t>(std::min(ceilf(right - 0.5f), static_cast<float>(pixels.width()))),
+                       color_);
+    }
+}
+
+void Shape::fillTransformed(const Transform2D& shape, bool round,
+                            const LinearGradient& gradient, LinearGradient::Type type) {
+    Point<float> lowerBound, upperBound;
+    getTransformedBounds(shape, round, lowerBound, upperBound);
+    if (shape.determinant() == 0.0f || clippedOut(lowerBound, upperBound)) {
+        return;
+    }
+    PooledRasterizer pooled;
+    Rasterizer& rasterizer = pooled;
+    addTransformed(shape, round, rasterizer);
+    fillSpans(rasterizer, Rasterizer::FillRule::NonZero, gradient, type, lowerBound, upperBound);
+}
+
+Canvas& Ellipse::draw(const Stroke& stroke) {
+    const auto scope = measure(RenderStats::Primitive::Ellipse);
+    if (stroke.thin()) {
+        return draw();
+    }
+    lowerBound_.swap(upperBound_);
+    const float a = std::abs(upperBound_.x() - lowerBound_.x()) / 2.0f;
+    const float b = std::abs(upperBound_.y() - lowerBound_.y()) / 2.0f;
+    const float half = stroke.width() / 2.0f;
+    const Point<float> center(lowerBound_.x() + a + 0.5f, lowerBound_.y() + b + 0.5f);
+    PooledRasterizer pooled;
+    Rasterizer& rasterizer = pooled;
+    Stroke::addEllipse(center, a + half, b + half, false, rasterizer);
+    if (a > half && b > half) {
+        Stroke::addEllipse(center, a - half, b - half, true, rasterizer);
+    }
+    fillSpans(rasterizer, Rasterizer::FillRule::NonZero);
+    return canvas_;
+}
+
 Canvas& Ellipse::draw() {
+    const auto scope = measure(RenderStats::Primitive::Ellipse);
     lowerBound_.swap(upperBound_);
+    if (clippedOut(lowerBound_, upperBound_)) {
+        return canvas_;
+    }
 
     const float width = std::abs(upperBound_.x() - lowerBound_.x());
     const float height = std::abs(upperBound_.y() - lowerBound_.y());
@@ -64,11 +424,17 @@ Canvas& Ellipse::draw() {
         return canvas_;
     }
     const Point<float> start(width / 2.0f + lowerBound_.x(), height + lowerBound_.y());
-    const Array<Point<float>> upperRight = generatePointsOnEllipseSegment();
-    const Array<Point<float>> upperLeft = mirrorEllipseSegment(upperRight, start, {start.x(), start.y() + 100});
-    const Array<Point<float>> lowerRight = mirrorEllipseSegment(upperRight, start, {start.x() + 100, start.y()});
-    const Array<Point<float>> lowerLeft = mirrorEllipseSegment(lowerRight, start, {start.x(), start.y() + 100});
-    for (size_t i = 0; i + 1 < upperRight.size(); i++) {
+    const size_t count = segmentPrecision + 2;
+    Arena::Scope scratch;
+    Point<float>* upperRight = Arena::local().allocate<Point<float>>(count);
+    Point<float>* upperLeft = Arena::local().allocate<Point<float>>(count);
+    Point<float>* lowerRight = Arena::local().allocate<Point<float>>(count);
+    Point<float>* lowerLeft = Arena::local().allocate<Point<float>>(count);
+    generatePointsOnEllipseSegment(upperRight, segmentPrecision);
+    mirrorEllipseSegment(upperRight, count, upperLeft, start, {start.x(), start.y() + 100});
+    mirrorEllipseSegment(upperRight, count, lowerRight, start, {start.x() + 100, start.y()});
+    mirrorEllipseSegment(lowerRight, count, lowerLeft, start, {start.x(), start.y() + 100});
+    for (size_t i = 0; i + 1 < count; i++) {
         drawLine(upperRight[i], upperRight[i + 1]);
         drawLine(upperLeft[i], upperLeft[i + 1]);
         drawLine({lowerRight[i].x(), lowerRight[i].y() - height},
@@ -80,43 +446,98 @@ Canvas& Ellipse::draw() {
     return canvas_;
 }
 
+Transform2D Ellipse::unitTransform(const Transform2D& transform) const {
+    const float a = (upperBound_.x() - lowerBound_.x() + 1.0f) / 2.0f;
+    const float b = (upperBound_.y() - lowerBound_.y() + 1.0f) / 2.0f;
+    return pixelSpace(transform) * Transform2D(a, 0.0f, 0.0f, b, lowerBound_.x() + a, lowerBound_.y() + b);
+}
+
+Canvas& Ellipse::fill(const Transform2D& transform) {
+    const auto scope = measure(RenderStats::Primitive::Ellipse);
+    lowerBound_.swap(upperBound_);
+    fillTransformed(unitTransform(transform), true);
+    return canvas_;
+}
+
+Canvas& Ellipse::fill(const LinearGradient& gradient, LinearGradient::Type type, const Transform2D& transform) {
+    const auto scope = measure(RenderStats::Primitive::Ellipse);
+    lowerBound_.swap(upperBound_);
+    fillTransformed(unitTransform(transform), true, gradient, type);
+    return canvas_;
+}
+
+void Ellipse::addTo(Rasterizer& rasterizer) const {
+    // Covers the same pixels as the aliased fill, which includes both bounding columns and rows.
+    const float a = (upperBound_.x() - lowerBound_.x() + 1.0f) / 2.0f;
+    const float b = (upperBound_.y() - lowerBound_.y() + 1.0f) / 2.0f;
+    Stroke::addEllipse({lowerBound_.x() + a, lowerBound_.y() + b}, a, b, false, rasterizer);
+}
+
 Canvas& Ellipse::fill() {
+    const auto scope = measure(RenderStats::Primitive::Ellipse);
     Pixels& pixels = canvas_.get();
     lowerBound_.swap(upperBound_);
+    if (clippedOut(lowerBound_, upperBound_)) {
+        return canvas_;
+    }
+    if (canvas_.antialiasing()) {
+        PooledRasterizer pooled;
+        Rasterizer& rasterizer = pooled;
+        addTo(rasterizer);
+        fillSpans(rasterizer, Rasterizer::FillRule::NonZero);
+        return canvas_;
+    }
 
     const auto width = static_cast<size_t>(std::abs(upperBound_.x() - lowerBound_.x()));
     const auto height = static_cast<size_t>(std::abs(upperBound_.y() - lowerBound_.y()));
     const auto widthF = static_cast<float>(width);
     const auto heightF = static_cast<float>(height);
-    for (size_t x = 0; x <= width / 2; x++) {
-        for (size_t  y = 0; y <= height / 2; y++) {
-            const auto xF = static_cast<float>(x);
-            const auto yF = static_cast<float>(y);
-            const float a = (xF + 0.5f) / (widthF / 2.0f) - 1.0f;
-            const float b = (yF + 0.5f) / (heightF / 2.0f) - 1.0f;
-            if (a * a + b * b <= 1.0f) {
-                pixels.set(static_cast<int64_t>(xF + lowerBound_.x()),
-                           static_cast<int64_t>(yF + lowerBound_.y()), color_);
-                pixels.set(static_cast<int64_t>(widthF - xF + lowerBound_.x()),
-                           static_cast<int64_t>(heightF - yF + lowerBound_.y()), color_);
-                pixels.set(static_cast<int64_t>(xF + lowerBound_.x()),
-                           static_cast<int64_t>(heightF - yF + lowerBound_.y()), color_);
-                pixels.set(static_cast<int64_t>(widthF - xF + lowerBound_.x()),
-                           static_cast<int64_t>(yF + lowerBound_.y()), color_);
+    if (width == 0 || height == 0) {
+        // The pixel test divides by the radius and accepts nothing.
+        return canvas_;
+    }
+    // The quarter [0, width / 2] x [0, height / 2] is mirrored onto the other three, so each row
+    // gets the widest quarter row landing on it, mirrored into one span.
+    const auto half = static_cast<int64_t>(height / 2);
+    Point<size_t> clipLower, clipUpper;
+    pixels.getClip(clipLower, clipUpper);
+    const auto firstRow = std::max(static_cast<int64_t>(clipLower.y()), static_cast<int64_t>(lowerBound_.y()));
+    const auto lastRow = std::min(static_cast<int64_t>(clipUpper.y()) - 1,
+                                  static_cast<int64_t>(heightF + lowerBound_.y()));
+    for (int64_t row = firstRow; row <= lastRow; row++) {
+        int64_t column = static_cast<int64_t>(width / 2) + 1;
+        for (const float estimate : {static_cast<float>(row) - lowerBound_.y(),
+                                     heightF + lowerBound_.y() - static_cast<float>(row)}) {
+            const auto near = static_cast<int64_t>(floorf(estimate));
+            for (int64_t y = std::max<int64_t>(0, near - 1); y <= std::min(half, near + 1); y++) {
+                const auto yF = static_cast<float>(y);
+                if (static_cast<int64_t>(yF + lowerBound_.y()) != row &&
+                    static_cast<int64_t>(heightF - yF + lowerBound_.y()) != row) {
+                    continue;
+                }
+                const auto run = ellipseRun(widthF / 2.0f, (yF + 0.5f) / (heightF / 2.0f) - 1.0f);
+                if (run.first <= run.second) {
+                    column = std::min(column, std::max<int64_t>(0, run.first));
+                }
             }
         }
+        if (column > static_cast<int64_t>(width / 2)) {
+            continue;
+        }
+        const auto xF = static_cast<float>(column);
+        pixels.setSpan(row, static_cast<int64_t>(xF + lowerBound_.x()),
+                       static_cast<int64_t>(widthF - xF + lowerBound_.x()) + 1, color_);
     }
     return canvas_;
 }
 
-Array<Point<float>> Ellipse::generatePointsOnEllipseSegment(size_t precision) {
+void Ellipse::generatePointsOnEllipseSegment(Point<float>* result, size_t precision) {
     const float width = std::abs(upperBound_.x() - lowerBound_.x());
     const float height = std::abs(upperBound_.y() - lowerBound_.y());
     const  float a = width / 2.0f;
     const float b = height / 2.0f;
     const float ratio = b / a;
 
-    Array<Point<float>> result(precision + 2);
     const size_t precisionD = precision / 2;
 
     result[0] = {a + lowerBound_.x(), height + lowerBound_.y()};
@@ -141,34 +562,41 @@ Array<Point<float>> Ellipse::generatePointsOnEllipseSegment(size_t precision) {
         result[precisionD + i + 2] = {start + a + lowerBound_.x(), y};
     }
 
-    result.sort();
-    return result;
+    std::sort(result, result + precision + 2);
 }
 
-Array<Point<float>> Ellipse::mirrorEllipseSegment(const Array<Point<float>>& points,
-                                                  const Point<float>& lineStart,
-                                                  const Point<float>& lineEnd) {
-    Array<Point<float>> result(points);
-    for (size_t i = 0; i < result.size(); i++) {
-        result[i].mirror(lineStart, lineEnd);
-    }
-    return result;
+void Ellipse::mirrorEllipseSegment(const Point<float>* points, size_t count, Point<float>* result,
+                                   const Point<float>& lineStart, const Point<float>& lineEnd) {
+    std::copy_n(points, count, result);
+    Transform2D::reflect(lineStart, lineEnd).apply(result, count);
 }
 
 Canvas& Ellipse::fill(const LinearGradient& gradient, LinearGradient::Type type) {
+    const auto scope = measure(RenderStats::Primitive::Ellipse);
     lowerBound_.swap(upperBound_);
+    if (clippedOut(lowerBound_, upperBound_)) {
+        return canvas_;
+    }
+    if (canvas_.antialiasing()) {
+        PooledRasterizer pooled;
+        Rasterizer& rasterizer = pooled;
+        addTo(rasterizer);
+        fillSpans(rasterizer, Rasterizer::FillRule::NonZero, gradient, type, lowerBound_,
+                  {upperBound_.x() + 1.0f, upperBound_.y() + 1.0f});
+        return canvas_;
+    }
     const auto width = std::abs(upperBound_.x() - lowerBound_.x());
     const auto height = std::abs(upperBound_.y() - lowerBound_.y());
     gradient.apply(canvas_.get(), lowerBound_, upperBound_,
-                   [width, height](size_t i, size_t j) {
-                       const float a = (static_cast<float>(i) + 0.5f) / (width / 2.0f) - 1.0f;
-                       const float b = (static_cast<float>(j) + 0.5f) / (height / 2.0f) - 1.0f;
-                       return a * a + b * b <= 1.0f;
-                       }, type);
+                   [width, height](int64_t j) {
+                       const auto run = ellipseRun(width / 2.0f, (static_cast<float>(j) + 0.5f) / (height / 2.0f) - 1.0f);
+                       return std::make_pair(run.first, run.second + 1);
+                   }, type);
     return canvas_;
 }
 
 Canvas& Rectangle::draw() {
+    const auto scope = measure(RenderStats::Primitive::Rectangle);
     lowerBound_.swap(upperBound_);
 
     const float width = std::abs(upperBound_.x() - lowerBound_.x());
@@ -180,34 +608,264 @@ Canvas& Rectangle::draw() {
     return canvas_;
 }
 
+Canvas& Rectangle::draw(const Stroke& stroke) {
+    const auto scope = measure(RenderStats::Primitive::Rectangle);
+    if (stroke.thin()) {
+        return draw();
+    }
+    lowerBound_.swap(upperBound_);
+    const float half = stroke.width() / 2.0f;
+    const float width = upperBound_.x() - lowerBound_.x();
+    const float height = upperBound_.y() - lowerBound_.y();
+    PooledRasterizer pooled;
+    Rasterizer& rasterizer = pooled;
+    Stroke::addRectangle({lowerBound_.x() + 0.5f - half, lowerBound_.y() + 0.5f - half},
+                         {upperBound_.x() + 0.5f + half, upperBound_.y() + 0.5f + half}, false, rasterizer);
+    if (width > stroke.width() && height > stroke.width()) {
+        Stroke::addRectangle({lowerBound_.x() + 0.5f + half, lowerBound_.y() + 0.5f + half},
+                             {upperBound_.x() + 0.5f - half, upperBound_.y() + 0.5f - half}, true, rasterizer);
+    }
+    fillSpans(rasterizer, Rasterizer::FillRule::NonZero);
+    return canvas_;
+}
+
+Transform2D Rectangle::unitTransform(const Transform2D& transform) const {
+    return pixelSpace(transform) * Transform2D(upperBound_.x() - lowerBound_.x() + 1.0f, 0.0f, 0.0f,
+                                               upperBound_.y() - lowerBound_.y() + 1.0f,
+                                               lowerBound_.x(), lowerBound_.y());
+}
+
+Canvas& Rectangle::fill(const Transform2D& transform) {
+    const auto scope = measure(RenderStats::Primitive::Rectangle);
+    lowerBound_.swap(upperBound_);
+    fillTransformed(unitTransform(transform), false);
+    return canvas_;
+}
+
+Canvas& Rectangle::fill(const LinearGradient& gradient, LinearGradient::Type type, const Transform2D& transform) {
+    const auto scope = measure(RenderStats::Primitive::Rectangle);
+    lowerBound_.swap(upperBound_);
+    fillTransformed(unitTransform(transform), false, gradient, type);
+    return canvas_;
+}
+
+void Rectangle::addTo(Rasterizer& rasterizer) const {
+    Stroke::addRectangle(lowerBound_, {upperBound_.x() + 1.0f, upperBound_.y() + 1.0f}, false, rasterizer);
+}
+
 Canvas& Rectangle::fill() {
+    const auto scope = measure(RenderStats::Primitive::Rectangle);
     Pixels& pixels = canvas_.get();
     lowerBound_.swap(upperBound_);
+    if (clippedOut(lowerBound_, upperBound_)) {
+        return canvas_;
+    }
+    if (canvas_.antialiasing()) {
+        PooledRasterizer pooled;
+        Rasterizer& rasterizer = pooled;
+        addTo(rasterizer);
+        fillSpans(rasterizer, Rasterizer::FillRule::NonZero);
+        return canvas_;
+    }
 
-    const auto width = static_cast<size_t>(std::abs(upperBound_.x() - lowerBound_.x()));
-    const auto height = static_cast<size_t>(std::abs(upperBound_.y() - lowerBound_.y()));
-    const auto widthF = static_cast<float>(width);
-    const auto heightF = static_cast<float>(height);
-    for (size_t x = 0; x <= width / 2; x++) {
-        for (size_t  y = 0; y <= height / 2; y++) {
-            const auto xF = static_cast<float>(x);
-            const auto yF = static_cast<float>(y);
-            pixels.set(static_cast<int64_t>(xF + lowerBound_.x()),
-                       static_cast<int64_t>(yF + lowerBound_.y()), color_);
-            pixels.set(static_cast<int64_t>(widthF - xF + lowerBound_.x()),
-                       static_cast<int64_t>(heightF - yF + lowerBound_.y()), color_);
-            pixels.set(static_cast<int64_t>(xF + lowerBound_.x()),
-                       static_cast<int64_t>(heightF - yF + lowerBound_.y()), color_);
-            pixels.set(static_cast<int64_t>(widthF - xF + lowerBound_.x()),
-                       static_cast<int64_t>(yF + lowerBound_.y()), color_);
-        }
+    // Both bounding rows and columns are filled.
+    const auto widthF = static_cast<float>(static_cast<size_t>(std::abs(upperBound_.x() - lowerBound_.x())));
+    const auto heightF = static_cast<float>(static_cast<size_t>(std::abs(upperBound_.y() - lowerBound_.y())));
+    const auto left = static_cast<int64_t>(lowerBound_.x());
+    const auto right = static_cast<int64_t>(widthF + lowerBound_.x()) + 1;
+    Point<size_t> clipLower, clipUpper;
+    pixels.getClip(clipLower, clipUpper);
+    const auto firstRow = std::max(static_cast<int64_t>(clipLower.y()), static_cast<int64_t>(lowerBound_.y()));
+    const auto lastRow = std::min(static_cast<int64_t>(clipUpper.y()),
+                                  static_cast<int64_t>(heightF + lowerBound_.y()) + 1);
+    for (int64_t row = firstRow; row < lastRow; row++) {
+        pixels.setSpan(row, left, right, color_);
     }
     return canvas_;
 }
 
 Canvas& Rectangle::fill(const LinearGradient& gradient, LinearGradient::Type type) {
+    const auto scope = measure(RenderStats::Primitive::Rectangle);
     lowerBound_.swap(upperBound_);
+    if (clippedOut(lowerBound_, upperBound_)) {
+        return canvas_;
+    }
+    if (canvas_.antialiasing()) {
+        PooledRasterizer pooled;
+        Rasterizer& rasterizer = pooled;
+        addTo(rasterizer);
+        fillSpans(rasterizer, Rasterizer::FillRule::NonZero, gradient, type, lowerBound_,
+                  {upperBound_.x() + 1.0f, upperBound_.y() + 1.0f});
+        return canvas_;
+    }
     gradient.apply(canvas_.get(), lowerBound_, upperBound_,
-                   [](size_t i, size_t j) { return true; }, type);
+                   [](int64_t) { return std::make_pair<int64_t, int64_t>(0, std::numeric_limits<int64_t>::max()); },
+                   type);
+    return canvas_;
+}
+
+void Polygon::addTo(Rasterizer& rasterizer) const {
+    for (size_t i = 0; i < points_.size(); i++) {
+        rasterizer.addEdge(points_[i], points_[(i + 1) % points_.size()]);
+    }
+}
+
+Polygon Polygon::transform(const Transform2D& transform) const {
+    Array<Point<float>> points(points_);
+    transform.apply(points);
+    return Polygon(canvas_, color_, points, rule_);
+}
+
+Canvas& Polygon::draw() {
+    const auto scope = measure(RenderStats::Primitive::Polygon);
+    for (size_t i = 0; i < points_.size(); i++) {
+        drawLine(points_[i], points_[(i + 1) % points_.size()]);
+    }
     return canvas_;
 }
+
+Canvas& Polygon::draw(const Stroke& stroke) {
+    const auto scope = measure(RenderStats::Primitive::Polygon);
+    if (stroke.thin()) {
+        return draw();
+    }
+    if (points_.size() > 0) {
+        strokeSpans(&points_[0], points_.size(), true, stroke);
+    }
+    return canvas_;
+}
+
+Canvas& Polygon::fill() {
+    const auto scope = measure(RenderStats::Primitive::Polygon);
+    PooledRasterizer pooled;
+    Rasterizer& rasterizer = pooled;
+    addTo(rasterizer);
+    fillSpans(rasterizer, rule_);
+    return canvas_;
+}
+
+Canvas& Polygon::fill(const LinearGradient& gradient, LinearGradient::Type type) {
+    const auto scope = measure(RenderStats::Primitive::Polygon);
+    if (points_.size() == 0) {
+        return canvas_;
+    }
+    Point<float> lowerBound = points_[0];
+    Point<float> upperBound = points_[0];
+    for (size_t i = 1; i < points_.size(); i++) {
+        lowerBound = {std::min(lowerBound.x(), points_[i].x()), std::min(lowerBound.y(), points_[i].y())};
+        upperBound = {std::max(upperBound.x(), points_[i].x()), std::max(upperBound.y(), points_[i].y())};
+    }
+    PooledRasterizer pooled;
+    Rasterizer& rasterizer = pooled;
+    addTo(rasterizer);
+    fillSpans(rasterizer, rule_, gradient, type, lowerBound, upperBound);
+    return canvas_;
+}
+
+void Figure::addTo(Rasterizer& rasterizer) const {
+    for (const auto& contour : path_.flatten(tolerance_)) {
+        rasterizer.addContour(contour.points.data(), contour.points.size());
+    }
+}
+
+Canvas& Figure::draw() {
+    const auto scope = measure(RenderStats::Primitive::Path);
+    for (const auto& contour : path_.flatten(tolerance_)) {
+        const auto& points = contour.points;
+        for (size_t i = 0; i + 1 < points.size(); i++) {
+            drawLine(points[i], points[i + 1]);
+        }
+        if (contour.closed && points.size() > 2) {
+            drawLine(points.back(), points.front());
+        }
+    }
+    return canvas_;
+}
+
+Canvas& Figure::draw(const Stroke& stroke) {
+    const auto scope = measure(RenderStats::Primitive::Path);
+    if (stroke.thin()) {
+        return draw();
+    }
+    for (const auto& contour : path_.flatten(tolerance_)) {
+        strokeSpans(contour.points.data(), contour.points.size(), contour.closed, stroke);
+    }
+    return canvas_;
+}
+
+Canvas& Figure::fill(Rasterizer::FillRule rule) {
+    const auto scope = measure(RenderStats::Primitive::Path);
+    PooledRasterizer pooled;
+    Rasterizer& rasterizer = pooled;
+    addTo(rasterizer);
+    fillSpans(rasterizer, rule);
+    return canvas_;
+}
+
+Canvas& Figure::fill(const LinearGradient& gradient, LinearGradient::Type type, Rasterizer::FillRule rule) {
+    const auto scope = measure(RenderStats::Primitive::Path);
+    Point<float> lowerBound, upperBound;
+    if (!path_.getBounds(lowerBound, upperBound, tolerance_)) {
+        return canvas_;
+    }
+    PooledRasterizer pooled;
+    Rasterizer& rasterizer = pooled;
+    addTo(rasterizer);
+    fillSpans(rasterizer, rule, gradient, type, lowerBound, upperBound);
+    return canvas_;
+}
+
+std::shared_ptr<const Font> Text::share(const Font& font) {
+    if (&font == &Font::standard()) {
+        return std::shared_ptr<const Font>(std::shared_ptr<const Font>(), &font);
+    }
+    return std::make_shared<const Font>(font);
+}
+
+Canvas& Text::draw() {
+    const auto scope = measure(RenderStats::Primitive::Text);
+    if (text_.empty() || scale_ == 0) {
+        return canvas_;
+    }
+    const auto scale = static_cast<int64_t>(scale_);
+    const auto left = static_cast<int64_t>(floorf(position_.x()));
+    const auto bottom = static_cast<int64_t>(floorf(position_.y()));
+    const auto lineStep = static_cast<int64_t>(font_->lineHeight()) * scale;
+    const auto lines = static_cast<int64_t>(std::count(text_.begin(), text_.end(), '\n'));
+    const Point<float> size = font_->measure(text_, scale_);
+    if (clippedOut({static_cast<float>(left), static_cast<float>(bottom - lines * lineStep)},
+                   {static_cast<float>(left) + size.x(),
+                    static_cast<float>(bottom + static_cast<int64_t>(font_->glyphHeight()) * scale)})) {
+        return canvas_;
+    }
+
+    Pixels& pixels = canvas_.get();
+    Point<size_t> lower, upper;
+    pixels.getClip(lower, upper);
+    const auto advance = static_cast<int64_t>(font_->advance()) * scale;
+    int64_t x = left;
+    int64_t y = bottom;
+    for (char character : text_) {
+        if (character == '\n') {
+            x = left;
+            y -= lineStep;
+            continue;
+        }
+        const auto runs = font_->runs(character);
+        for (const Font::Run* run = runs.first; run != runs.second; run++) {
+            const int64_t x0 = x + run->x0 * scale;
+            const int64_t x1 = x + run->x1 * scale;
+            const int64_t top = y + run->y * scale;
+            const int64_t last = std::min(top + scale, static_cast<int64_t>(upper.y()));
+            for (int64_t row = std::max(top, static_cast<int64_t>(lower.y())); row < last; row++) {
+                if (run->coverage == 255) {
+                    pixels.setSpan(row, x0, x1, color_);
+                } else {
+                    pixels.blendSpan(row, x0, x1, color_, run->coverage);
+                }
+            }
+        }
+        x += advance;
+    }
+    return canvas_;
+}
\ No newline at end of file
@@ -1,8 +1,16 @@
 #pragma once
 #include "Color.h"
 #include "Canvas.h"
+#include "Font.h"
 #include "Array.h"
+#include "Path.h"
+#include "Rasterizer.h"
+#include "Stroke.h"
+#include "Transform2D.h"
 #include <limits>
+#include <memory>
+#include <string>
+#include <utility>
 
 namespace sglib {
     class Shape {
@@ -15,7 +23,27 @@ namespace sglib {
         Canvas& canvas_;
         Color color_;
 
+        // True when nothing in [lowerBound, upperBound], in pixel units, can reach the canvas clip.
+        bool clippedOut(const Point<float>& lowerBound, const Point<float>& upperBound) const;
+        // Keep the result alive for the whole draw or fill so its work is charged to `primitive`.
+        RenderStats::Scope measure(RenderStats::Primitive primitive) const;
         void drawLine(Point<float> start, Point<float> end);
+        void drawSmoothLine(Point<float> start, Point<float> end);
+        void fillSpans(Rasterizer& rasterizer, Rasterizer::FillRule rule);
+        void fillSpans(Rasterizer& rasterizer, Rasterizer::FillRule rule,
+                       const LinearGradient& gradient, LinearGradient::Type type,
+                       const Point<float>& lowerBound, const Point<float>& upperBound);
+        void strokeSpans(const Point<float>* points, size_t count, bool closed, const Stroke& stroke);
+        // `shape` maps the unit square [0, 1]^2, or the unit disc when `round`, onto the canvas.
+        void fillTransformed(const Transform2D& shape, bool round);
+        void fillTransformed(const Transform2D& shape, bool round,
+                             const LinearGradient& gradient, LinearGradient::Type type);
+        static Transform2D pixelSpace(const Transform2D& transform);
+
+    private:
+        static void addTransformed(const Transform2D& shape, bool round, Rasterizer& rasterizer);
+        static void getTransformedBounds(const Transform2D& shape, bool round,
+                                         Point<float>& lowerBound, Point<float>& upperBound);
     };
 
     class Line : public Shape {
@@ -23,8 +51,10 @@ namespace sglib {
         Line(Canvas& canvas, const Color& color, Point<float> start, Point<float> finish) :
                 Shape(canvas, color), start_(start), finish_(finish) { }
         Canvas& draw() override;
+        Canvas& draw(const Stroke& stroke);
         Line rotate(Point<float> origin, int angle);
         Line mirror(const Line& other);
+        Line transform(const Transform2D& transform) const;
         ~Line() override = default;
     private:
         Point<float> start_, finish_;
@@ -39,17 +69,23 @@ namespace sglib {
                 upperBound_(upperBound) { }
         Canvas& fill();
         Canvas& fill(const LinearGradient& gradient, LinearGradient::Type type);
+        Canvas& fill(const Transform2D& transform);
+        Canvas& fill(const LinearGradient& gradient, LinearGradient::Type type, const Transform2D& transform);
         Canvas& draw() override;
+        Canvas& draw(const Stroke& stroke);
         ~Ellipse() override = default;
     private:
         Point<float> lowerBound_;
         Point<float> upperBound_;
 
+        const static size_t segmentPrecision = 20;
 
-        Array<Point<float>> generatePointsOnEllipseSegment(size_t precision = 20);
-        Array<Point<float>> mirrorEllipseSegment(const Array<Point<float>>& points,
-                                                 const Point<float>& lineStart,
-                                                 const Point<float>& lineEnd);
+        void addTo(Rasterizer& rasterizer) const;
+        Transform2D unitTransform(const Transform2D& transform) const;
+        // Writes precision + 2 points.
+        void generatePointsOnEllipseSegment(Point<float>* result, size_t precision);
+        static void mirrorEllipseSegment(const Point<float>* points, size_t count, Point<float>* result,
+                                         const Point<float>& lineStart, const Point<float>& lineEnd);
     };
 
     class Rectangle : public Shape {
@@ -61,10 +97,80 @@ namespace sglib {
         upperBound_(upperBound) { }
         Canvas& fill();
         Canvas& fill(const LinearGradient& gradient, LinearGradient::Type type);
+        Canvas& fill(const Transform2D& transform);
+        Canvas& fill(const LinearGradient& gradient, LinearGradient::Type type, const Transform2D& transform);
         Canvas& draw() override;
+        Canvas& draw(const Stroke& stroke);
         ~Rectangle() override = default;
     private:
         Point<float> lowerBound_;
         Point<float> upperBound_;
+
+        void addTo(Rasterizer& rasterizer) const;
+        Transform2D unitTransform(const Transform2D& transform) const;
+    };
+
+    class Polygon : public Shape {
+    public:
+        Polygon(Canvas& canvas, const Color& color, const Array<Point<float>>& points,
+                Rasterizer::FillRule rule = Rasterizer::FillRule::NonZero) :
+                Shape(canvas, color),
+                points_(points),
+                rule_(rule) { }
+        Canvas& fill();
+        Canvas& fill(const LinearGradient& gradient, LinearGradient::Type type);
+        Canvas& draw() override;
+        Canvas& draw(const Stroke& stroke);
+        Polygon transform(const Transform2D& transform) const;
+        ~Polygon() override = default;
+    private:
+        Array<Point<float>> points_;
+        Rasterizer::FillRule rule_;
+
+        void addTo(Rasterizer& rasterizer) const;
+    };
+
+    class Figure : public Shape {
+    public:
+        Figure(Canvas& canvas, const Color& color, Path path, float tolerance = 0.25f) :
+               Shape(canvas, color),
+               path_(std::move(path)),
+               tolerance_(tolerance) { }
+        Canvas& fill(Rasterizer::FillRule rule = Rasterizer::FillRule::NonZero);
+        Canvas& fill(const LinearGradient& gradient, LinearGradient::Type type,
+                     Rasterizer::FillRule rule = Rasterizer::FillRule::NonZero);
+        Canvas& draw() override;
+        Canvas& draw(const Stroke& stroke);
+        ~Figure() override = default;
+    private:
+        Path path_;
+        float tolerance_;
+
+        void addTo(Rasterizer& rasterizer) const;
+    };
+
+    class Text : public Shape {
+    public:
+        // `position` is the lower left corner of the first line; further lines go downwards.
+        Text(Canvas& canvas, const Color& color, Point<float> position, std::string text,
+             std::shared_ptr<const Font> font, size_t scale = 1) :
+             Shape(canvas, color),
+             position_(position),
+             text_(std::move(text)),
+             font_(std::move(font)),
+             scale_(scale) { }
+        // Copies `font` unless it is the standard one, so the text never outlives its font.
+        Text(Canvas& canvas, const Color& color, Point<float> position, std::string text,
+             const Font& font = Font::standard(), size_t scale = 1) :
+             Text(canvas, color, position, std::move(text), share(font), scale) { }
+        Canvas& draw() override;
+        ~Text() override = default;
+    private:
+        Point<float> position_;
+        std::string text_;
+        std::shared_ptr<const Font> font_;
+        size_t scale_;
+
+        static std::shared_ptr<const Font> share(const Font& font);
     };
 }
\ No newline at end of file
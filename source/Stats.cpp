@@ -0,0 +1,142 @@
+#include "Stats.h"
+#include <sstream>
+
+using namespace sglib;
+
+#ifdef SGLIB_STATS
+namespace {
+    uint64_t since(std::chrono::steady_clock::time_point start) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+RenderStats::Scope::Scope(RenderStats& stats, const Pixels& pixels, Primitive primitive) :
+        stats(stats), pixels(pixels), primitive(primitive), outermost(stats.depth++ == 0),
+        written(pixels.pixelsWritten()), rejected(pixels.pixelsClipped()) {
+    if (outermost) {
+        start = std::chrono::steady_clock::now();
+    }
+}
+
+RenderStats::Scope::~Scope() {
+    stats.depth--;
+    if (!outermost) {
+        return;
+    }
+    Counters& counters = stats.primitives[static_cast<size_t>(primitive)];
+    counters.calls++;
+    counters.pixels += pixels.pixelsWritten() - written;
+    counters.clippedPixels += pixels.pixelsClipped() - rejected;
+    counters.nanoseconds += since(start);
+}
+
+RenderStats::TransferScope::TransferScope(RenderStats& stats, Codec codec) :
+        stats(stats), codec(codec), start(std::chrono::steady_clock::now()) { }
+
+RenderStats::TransferScope::~TransferScope() {
+    Transfer& transfer = stats.transfers[static_cast<size_t>(codec)];
+    transfer.calls++;
+    transfer.nanoseconds += since(start);
+}
+
+void RenderStats::countTransfer(Codec codec, uint64_t bytes) {
+    Transfer& transfer = transfers[static_cast<size_t>(codec)];
+    transfer.bytes += bytes;
+    transfer.ioCalls++;
+}
+#endif
+
+bool RenderStats::enabled() {
+#ifdef SGLIB_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char* RenderStats::name(Primitive primitive) {
+    switch (primitive) {
+        case Primitive::Line: return "line";
+        case Primitive::Ellipse: return "ellipse";
+        case Primitive::Rectangle: return "rectangle";
+        case Primitive::Polygon: return "polygon";
+        case Primitive::Path: return "path";
+        case Primitive::Text: return "text";
+        case Primitive::Fill: return "fill";
+        case Primitive::FloodFill: return "flood_fill";
+    }
+    return "unknown";
+}
+
+const char* RenderStats::name(Codec codec) {
+    return codec == Codec::Encode ? "encode" : "decode";
+}
+
+const RenderStats::Counters& RenderStats::get(Primitive primitive) const {
+    return primitives[static_cast<size_t>(primitive)];
+}
+
+const RenderStats::Transfer& RenderStats::get(Codec codec) const {
+    return transfers[static_cast<size_t>(codec)];
+}
+
+RenderStats::Counters RenderStats::total() const {
+    Counters result;
+    for (const Counters& counters : primitives) {
+        result.calls += counters.calls;
+        result.pixels += counters.pixels;
+        result.clippedPixels += counters.clippedPixels;
+        result.nanoseconds += counters.nanoseconds;
+    }
+    return result;
+}
+
+void RenderStats::reset() {
+    primitives.fill(Counters());
+    transfers.fill(Transfer());
+}
+
+RenderStats& RenderStats::operator+=(const RenderStats& other) {
+    for (size_t i = 0; i < primitives.size(); i++) {
+        primitives[i].calls += other.primitives[i].calls;
+        primitives[i].pixels += other.primitives[i].pixels;
+        primitives[i].clippedPixels += other.primitives[i].clippedPixels;
+        primitives[i].nanoseconds += other.primitives[i].nanoseconds;
+    }
+    for (size_t i = 0; i < transfers.size(); i++) {
+        transfers[i].calls += other.transfers[i].calls;
+        transfers[i].bytes += other.transfers[i].bytes;
+        transfers[i].ioCalls += other.transfers[i].ioCalls;
+        transfers[i].nanoseconds += other.transfers[i].nanoseconds;
+    }
+    return *this;
+}
+
+void RenderStats::writeJson(std::ostream& out) const {
+    out << "{\"enabled\": " << (enabled() ? "true" : "false") << ", \"primitives\": {";
+    for (size_t i = 0; i < primitives.size(); i++) {
+        const Counters& counters = primitives[i];
+        out << (i == 0 ? "" : ", ") << "\"" << name(static_cast<Primitive>(i)) << "\": {"
+            << "\"calls\": " << counters.calls
+            << ", \"pixels\": " << counters.pixels
+            << ", \"clipped_pixels\": " << counters.clippedPixels
+            << ", \"nanoseconds\": " << counters.nanoseconds << "}";
+    }
+    out << "}, \"codecs\": {";
+    for (size_t i = 0; i < transfers.size(); i++) {
+        const Transfer& transfer = transfers[i];
+        out << (i == 0 ? "" : ", ") << "\"" << name(static_cast<Codec>(i)) << "\": {"
+            << "\"calls\": " << transfer.calls
+            << ", \"bytes\": " << transfer.bytes
+            << ", \"io_calls\": " << transfer.ioCalls
+            << ", \"nanoseconds\": " << transfer.nanoseconds << "}";
+    }
+    out << "}}";
+}
+
+std::string RenderStats::json() const {
+    std::ostringstream out;
+    writeJson(out);
+    return out.str();
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include "Pixels.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace sglib {
+    // Render counters, recorded only when the library is built with SGLIB_STATS defined
+    // (bazel build --define sglib_stats=1). Otherwise every recording hook compiles to nothing
+    // and all counters stay zero.
+    class RenderStats {
+    public:
+        enum class Primitive {
+            Line,
+            Ellipse,
+            Rectangle,
+            Polygon,
+            Path,
+            Text,
+            Fill,
+            FloodFill
+        };
+
+        enum class Codec {
+            Encode,
+            Decode
+        };
+
+        class Counters {
+        public:
+            uint64_t calls = 0;
+            uint64_t pixels = 0;
+            // Pixels a writer was asked for but dropped because they lay outside the clip.
+            uint64_t clippedPixels = 0;
+            uint64_t nanoseconds = 0;
+        };
+
+        class Transfer {
+        public:
+            uint64_t calls = 0;
+            uint64_t bytes = 0;
+            // Reads, writes and seeks issued to the file stream; its buffer may merge several
+            // of them into one system call.
+            uint64_t ioCalls = 0;
+            uint64_t nanoseconds = 0;
+        };
+
+        // Charges the time and pixels spent while it is alive to one primitive. Scopes opened
+        // inside another one are not counted again, so a shape drawn through another shape
+        // is accounted once, to the outer one.
+        class Scope {
+        public:
+            Scope(RenderStats& stats, const Pixels& pixels, Primitive primitive);
+            Scope(const Scope& other) = delete;
+            Scope& operator=(const Scope& other) = delete;
+            ~Scope();
+
+        private:
+#ifdef SGLIB_STATS
+            RenderStats& stats;
+            const Pixels& pixels;
+            Primitive primitive;
+            bool outermost;
+            uint64_t written, rejected;
+            std::chrono::steady_clock::time_point start;
+#endif
+        };
+
+        class TransferScope {
+        public:
+            TransferScope(RenderStats& stats, Codec codec);
+            TransferScope(const TransferScope& other) = delete;
+            TransferScope& operator=(const TransferScope& other) = delete;
+            ~TransferScope();
+
+        private:
+#ifdef SGLIB_STATS
+            RenderStats& stats;
+            Codec codec;
+            std::chrono::steady_clock::time_point start;
+#endif
+        };
+
+        static bool enabled();
+        static const char* name(Primitive primitive);
+        static const char* name(Codec codec);
+
+        const Counters& get(Primitive primitive) const;
+        const Transfer& get(Codec codec) const;
+        Counters total() const;
+        void countTransfer(Codec codec, uint64_t bytes);
+        void reset();
+        RenderStats& operator+=(const RenderStats& other);
+        void writeJson(std::ostream& out) const;
+        std::string json() const;
+
+    private:
+        std::array<Counters, 8> primitives;
+        std::array<Transfer, 2> transfers;
+        size_t depth = 0;
+    };
+
+#ifndef SGLIB_STATS
+    inline RenderStats::Scope::Scope(RenderStats&, const Pixels&, Primitive) { }
+
+    inline RenderStats::Scope::~Scope() = default;
+
+    inline RenderStats::TransferScope::TransferScope(RenderStats&, Codec) { }
+
+    inline RenderStats::TransferScope::~TransferScope() = default;
+
+    inline void RenderStats::countTransfer(Codec, uint64_t) { }
+#endif
+}
@@ -0,0 +1,134 @@
+#include "Stroke.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace sglib;
+
+namespace {
+    const float tolerance = 0.25f;
+
+    size_t segmentsFor(float radius) {
+        if (radius <= tolerance) {
+            return 8;
+        }
+        const float step = acosf(1.0f - tolerance / radius);
+        return std::min<size_t>(1024, std::max<size_t>(8, static_cast<size_t>(ceilf(static_cast<float>(M_PI) / step))));
+    }
+
+    void addCircle(const Point<float>& center, float radius, std::vector<Point<float>>& polygon) {
+        const size_t count = segmentsFor(radius);
+        polygon.clear();
+        for (size_t i = 0; i < count; i++) {
+            const float angle = 2.0f * static_cast<float>(M_PI) * static_cast<float>(i) / static_cast<float>(count);
+            polygon.emplace_back(center.x() + radius * cosf(angle), center.y() + radius * sinf(angle));
+        }
+    }
+}
+
+float Stroke::width() const {
+    return strokeWidth;
+}
+
+Stroke::Cap Stroke::cap() const {
+    return strokeCap;
+}
+
+bool Stroke::thin() const {
+    return strokeWidth <= 1.0f;
+}
+
+void Stroke::addOriented(std::vector<Point<float>>& polygon, bool hole, Rasterizer& rasterizer) {
+    float area = 0.0f;
+    for (size_t i = 0; i < polygon.size(); i++) {
+        const Point<float>& a = polygon[i];
+        const Point<float>& b = polygon[(i + 1) % polygon.size()];
+        area += a.x() * b.y() - b.x() * a.y();
+    }
+    if ((area < 0.0f) != hole) {
+        std::reverse(polygon.begin(), polygon.end());
+    }
+    rasterizer.addContour(polygon.data(), polygon.size());
+}
+
+void Stroke::addEllipse(const Point<float>& center, float a, float b, bool hole, Rasterizer& rasterizer) {
+    addEllipse(Transform2D(a, 0.0f, 0.0f, b, center.x(), center.y()), hole, rasterizer);
+}
+
+void Stroke::addEllipse(const Transform2D& transform, bool hole, Rasterizer& rasterizer) {
+    // Kept per thread, so that outlining reuses the capacity grown by earlier calls.
+    thread_local std::vector<Point<float>> polygon;
+    polygon.clear();
+    const float radius = std::max(sqrtf(transform.xx * transform.xx + transform.yx * transform.yx),
+                                  sqrtf(transform.xy * transform.xy + transform.yy * transform.yy));
+    const size_t count = segmentsFor(radius);
+    for (size_t i = 0; i < count; i++) {
+        const float angle = 2.0f * static_cast<float>(M_PI) * static_cast<float>(i) / static_cast<float>(count);
+        polygon.push_back(transform.apply({cosf(angle), sinf(angle)}));
+    }
+    addOriented(polygon, hole, rasterizer);
+}
+
+void Stroke::addRectangle(const Point<float>& lowerBound, const Point<float>& upperBound, bool hole,
+                          Rasterizer& rasterizer) {
+    thread_local std::vector<Point<float>> polygon;
+    polygon = {{lowerBound.x(), lowerBound.y()}, {upperBound.x(), lowerBound.y()},
+               {upperBound.x(), upperBound.y()}, {lowerBound.x(), upperBound.y()}};
+    addOriented(polygon, hole, rasterizer);
+}
+
+void Stroke::outline(const Point<float>* points, size_t count, bool closed, Rasterizer& rasterizer) const {
+    if (count == 0) {
+        return;
+    }
+    const float half = strokeWidth / 2.0f;
+    thread_local std::vector<Point<float>> polygon;
+    const size_t segments = closed ? count : count - 1;
+    for (size_t i = 0; i < segments; i++) {
+        Point<float> start = points[i];
+        Point<float> finish = points[(i + 1) % count];
+        const float dx = finish.x() - start.x();
+        const float dy = finish.y() - start.y();
+        const float length = sqrtf(dx * dx + dy * dy);
+        if (length == 0.0f) {
+            continue;
+        }
+        const float ux = dx / length * half;
+        const float uy = dy / length * half;
+        if (!closed && strokeCap == Cap::Square) {
+            if (i == 0) {
+                start = {start.x() - ux, start.y() - uy};
+            }
+            if (i + 1 == segments) {
+                finish = {finish.x() + ux, finish.y() + uy};
+            }
+        }
+        polygon = {{start.x() - uy, start.y() + ux},
+                   {finish.x() - uy, finish.y() + ux},
+                   {finish.x() + uy, finish.y() - ux},
+                   {start.x() + uy, start.y() - ux}};
+        addOriented(polygon, false, rasterizer);
+    }
+
+    const size_t firstJoin = closed ? 0 : 1;
+    const size_t lastJoin = closed ? count : count - 1;
+    for (size_t i = firstJoin; i < lastJoin; i++) {
+        addCircle(points[i], half, polygon);
+        addOriented(polygon, false, rasterizer);
+    }
+
+    if (!closed && (strokeCap == Cap::Round || (segments == 0 && strokeCap == Cap::Square))) {
+        if (strokeCap == Cap::Square) {
+            const Point<float>& point = points[0];
+            polygon = {{point.x() - half, point.y() - half}, {point.x() + half, point.y() - half},
+                       {point.x() + half, point.y() + half}, {point.x() - half, point.y() + half}};
+            addOriented(polygon, false, rasterizer);
+            return;
+        }
+        addCircle(points[0], half, polygon);
+        addOriented(polygon, false, rasterizer);
+        if (count > 1) {
+            addCircle(points[count - 1], half, polygon);
+            addOriented(polygon, false, rasterizer);
+        }
+    }
+}
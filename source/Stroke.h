@@ -0,0 +1,38 @@
+#pragma once
+#include "Point.h"
+#include "Rasterizer.h"
+#include "Transform2D.h"
+#include <vector>
+
+namespace sglib {
+    class Stroke {
+    public:
+        enum class Cap {
+            Butt,
+            Square,
+            Round
+        };
+
+        Stroke(float width = 1.0f, Cap cap = Cap::Butt) : strokeWidth(width), strokeCap(cap) { }
+
+        float width() const;
+        Cap cap() const;
+        bool thin() const;
+
+        // Adds the area covered by stroking the polyline as contours that all wind the same way,
+        // so rasterizing them with the non-zero rule fills their union and writes each pixel once.
+        void outline(const Point<float>* points, size_t count, bool closed, Rasterizer& rasterizer) const;
+        // Holes wind the opposite way, so they cut out of the shapes they lie in under non-zero.
+        static void addEllipse(const Point<float>& center, float a, float b, bool hole, Rasterizer& rasterizer);
+        // The ellipse is the image of the unit circle under `transform`.
+        static void addEllipse(const Transform2D& transform, bool hole, Rasterizer& rasterizer);
+        static void addRectangle(const Point<float>& lowerBound, const Point<float>& upperBound, bool hole,
+                                 Rasterizer& rasterizer);
+
+    private:
+        float strokeWidth;
+        Cap strokeCap;
+
+        static void addOriented(std::vector<Point<float>>& polygon, bool hole, Rasterizer& rasterizer);
+    };
+}
@@ -0,0 +1,98 @@
+#include "Transform2D.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace sglib;
+
+Transform2D Transform2D::translate(float dx, float dy) {
+    return {1.0f, 0.0f, 0.0f, 1.0f, dx, dy};
+}
+
+Transform2D Transform2D::scale(float sx, float sy, const Point<float>& origin) {
+    return {sx, 0.0f, 0.0f, sy, origin.x() - sx * origin.x(), origin.y() - sy * origin.y()};
+}
+
+Transform2D Transform2D::rotate(float degrees, const Point<float>& origin) {
+    if (fmodf(degrees, 360.0f) == 0.0f) {
+        return {};
+    }
+    const float radians = degrees * static_cast<float>(M_PI) / -180.0f;
+    const float s = sinf(radians);
+    const float c = cosf(radians);
+    return {c, s, -s, c,
+            origin.x() - c * origin.x() + s * origin.y(),
+            origin.y() - s * origin.x() - c * origin.y()};
+}
+
+Transform2D Transform2D::reflect(const Point<float>& lineStart, const Point<float>& lineFinish) {
+    const float dx = lineFinish.x() - lineStart.x();
+    const float dy = lineFinish.y() - lineStart.y();
+    const float length = dx * dx + dy * dy;
+    if (length == 0.0f) {
+        throw std::invalid_argument("reflection line is degenerate");
+    }
+    const float a = (dx * dx - dy * dy) / length;
+    const float b = 2.0f * dx * dy / length;
+    return {a, b, b, -a,
+            lineStart.x() - a * lineStart.x() - b * lineStart.y(),
+            lineStart.y() - b * lineStart.x() + a * lineStart.y()};
+}
+
+Transform2D Transform2D::operator*(const Transform2D& other) const {
+    return {xx * other.xx + xy * other.yx,
+            yx * other.xx + yy * other.yx,
+            xx * other.xy + xy * other.yy,
+            yx * other.xy + yy * other.yy,
+            xx * other.tx + xy * other.ty + tx,
+            yx * other.tx + yy * other.ty + ty};
+}
+
+float Transform2D::determinant() const {
+    return xx * yy - xy * yx;
+}
+
+Transform2D Transform2D::inverse() const {
+    const float det = determinant();
+    if (det == 0.0f) {
+        throw std::invalid_argument("transform is not invertible");
+    }
+    return {yy / det, -yx / det, -xy / det, xx / det,
+            (xy * ty - yy * tx) / det,
+            (yx * tx - xx * ty) / det};
+}
+
+bool Transform2D::identity() const {
+    return xx == 1.0f && yx == 0.0f && xy == 0.0f && yy == 1.0f && tx == 0.0f && ty == 0.0f;
+}
+
+Point<float> Transform2D::apply(const Point<float>& point) const {
+    return {xx * point.x() + xy * point.y() + tx, yx * point.x() + yy * point.y() + ty};
+}
+
+void Transform2D::apply(Point<float>* points, size_t count) const {
+    // Locals, so that the stores cannot alias the coefficients, and whole blocks with a fixed
+    // trip count: together they let the compiler turn the loop into packed float arithmetic.
+    const float a = xx, b = yx, c = xy, d = yy, e = tx, f = ty;
+    const size_t block = 64;
+    size_t start = 0;
+    for (; start + block <= count; start += block) {
+        Point<float>* chunk = points + start;
+        for (size_t i = 0; i < block; i++) {
+            const float x = chunk[i].x();
+            const float y = chunk[i].y();
+            chunk[i] = {a * x + c * y + e, b * x + d * y + f};
+        }
+    }
+    for (size_t i = start; i < count; i++) {
+        const float x = points[i].x();
+        const float y = points[i].y();
+        points[i] = {a * x + c * y + e, b * x + d * y + f};
+    }
+}
+
+void Transform2D::apply(Array<Point<float>>& points) const {
+    if (points.size() > 0) {
+        apply(&points[0], points.size());
+    }
+}
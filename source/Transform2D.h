@@ -0,0 +1,32 @@
+#pragma once
+#include "Array.h"
+#include "Point.h"
+
+namespace sglib {
+    // Affine map x' = xx * x + xy * y + tx, y' = yx * x + yy * y + ty.
+    class Transform2D {
+    public:
+        Transform2D() : xx(1.0f), yx(0.0f), xy(0.0f), yy(1.0f), tx(0.0f), ty(0.0f) { }
+        Transform2D(float xx, float yx, float xy, float yy, float tx, float ty) :
+                xx(xx), yx(yx), xy(xy), yy(yy), tx(tx), ty(ty) { }
+
+        static Transform2D translate(float dx, float dy);
+        static Transform2D scale(float sx, float sy, const Point<float>& origin = Point<float>());
+        // Same direction as Point::rotate.
+        static Transform2D rotate(float degrees, const Point<float>& origin = Point<float>());
+        // Same reflection as Point::mirror.
+        static Transform2D reflect(const Point<float>& lineStart, const Point<float>& lineFinish);
+
+        // Applies `other` first, then this transform.
+        Transform2D operator*(const Transform2D& other) const;
+        Transform2D inverse() const;
+        float determinant() const;
+        bool identity() const;
+        Point<float> apply(const Point<float>& point) const;
+        // Transforms in place in fixed-size blocks, which the compiler vectorizes.
+        void apply(Point<float>* points, size_t count) const;
+        void apply(Array<Point<float>>& points) const;
+
+        float xx, yx, xy, yy, tx, ty;
+    };
+}
@@ -0,0 +1,302 @@
+#include "Canvas.h"
+#include "Bitmap.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace sglib;
+
+namespace {
+    class Benchmark {
+    public:
+        string name;
+        // Work done by one operation, for the throughput columns; 0 leaves a column out.
+        double pixels;
+        double bytes;
+        function<void()> operation;
+    };
+
+    class Result {
+    public:
+        string name;
+        size_t iterations;
+        vector<double> samples;
+        double mean, deviation, minimum;
+        double pixelsPerSecond, bytesPerSecond;
+    };
+
+    class Options {
+    public:
+        string filter;
+        string json;
+        size_t repetitions = 10;
+        double minimalTime = 0.05;
+        double warmupTime = 0.02;
+    };
+
+    using Clock = chrono::steady_clock;
+
+    // Results the benchmarks store so the work producing them is not optimized away.
+    volatile uint8_t sink;
+
+    double seconds(Clock::time_point start) {
+        return chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Picks an iteration count that makes one repetition last at least `minimalTime`, warming up
+    // caches and allocations on the way, then times `repetitions` runs of that many iterations.
+    Result run(const Benchmark& benchmark, const Options& options) {
+        size_t iterations = 1;
+        const auto warmup = Clock::now();
+        while (true) {
+            const auto start = Clock::now();
+            for (size_t i = 0; i < iterations; i++) {
+                benchmark.operation();
+            }
+            const double elapsed = seconds(start);
+            if (elapsed >= options.minimalTime && seconds(warmup) >= options.warmupTime) {
+                break;
+            }
+            const double factor = elapsed <= 0.0 ? 10.0 : std::min(10.0, std::max(1.5, options.minimalTime / elapsed));
+            iterations = static_cast<size_t>(ceil(static_cast<double>(iterations) * factor));
+        }
+
+        Result result{};
+        result.name = benchmark.name;
+        result.iterations = iterations;
+        for (size_t repetition = 0; repetition < options.repetitions; repetition++) {
+            const auto start = Clock::now();
+            for (size_t i = 0; i < iterations; i++) {
+                benchmark.operation();
+            }
+            result.samples.push_back(seconds(start) * 1e9 / static_cast<double>(iterations));
+        }
+        double sum = 0.0;
+        for (double sample : result.samples) {
+            sum += sample;
+        }
+        result.mean = sum / static_cast<double>(result.samples.size());
+        double squares = 0.0;
+        for (double sample : result.samples) {
+            squares += (sample - result.mean) * (sample - result.mean);
+        }
+        result.deviation = result.samples.size() > 1 ? sqrt(squares / static_cast<double>(result.samples.size() - 1)) : 0.0;
+        result.minimum = *min_element(result.samples.begin(), result.samples.end());
+        result.pixelsPerSecond = benchmark.pixels * 1e9 / result.mean;
+        result.bytesPerSecond = benchmark.bytes * 1e9 / result.mean;
+        return result;
+    }
+
+    string escape(const string& text) {
+        string result;
+        for (char character : text) {
+            if (character == '"' || character == '\\') {
+                result += '\\';
+            }
+            result += character;
+        }
+        return result;
+    }
+
+    void writeJson(ostream& out, const vector<Result>& results, const Options& options) {
+        out << "{\n  \"repetitions\": " << options.repetitions << ",\n  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& result = results[i];
+            out << (i == 0 ? "\n" : ",\n")
+                << "    {\"name\": \"" << escape(result.name) << "\""
+                << ", \"iterations\": " << result.iterations
+                << ", \"ns_per_op\": " << result.mean
+                << ", \"ns_per_op_stddev\": " << result.deviation
+                << ", \"ns_per_op_min\": " << result.minimum
+                << ", \"pixels_per_second\": " << result.pixelsPerSecond
+                << ", \"bytes_per_second\": " << result.bytesPerSecond
+                << ", \"samples_ns\": [";
+            for (size_t j = 0; j < result.samples.size(); j++) {
+                out << (j == 0 ? "" : ", ") << result.samples[j];
+            }
+            out << "]}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    string rate(double value, const char* unit) {
+        if (value <= 0.0) {
+            return "-";
+        }
+        const char* prefixes[] = {"", "K", "M", "G", "T"};
+        size_t index = 0;
+        while (value >= 1000.0 && index + 1 < sizeof(prefixes) / sizeof(prefixes[0])) {
+            value /= 1000.0;
+            index++;
+        }
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.2f %s%s/s", value, prefixes[index], unit);
+        return buffer;
+    }
+
+    const size_t width = 1920;
+    const size_t height = 1080;
+
+    vector<Benchmark> benchmarks(const string& directory) {
+        const double frame = static_cast<double>(width * height);
+        static Canvas canvas(width, height);
+        static Pixels image(width, height, Color::white, Pixels::Storage::Tiled);
+        vector<Benchmark> result;
+
+        result.push_back({"fill/solid-lazy", frame, frame * sizeof(Color), [] {
+            canvas.fill(Color::blue);
+        }});
+        result.push_back({"fill/solid", frame, frame * sizeof(Color), [] {
+            canvas.get().setRange({0, 0}, {width, height}, Color::green);
+        }});
+        result.push_back({"fill/gradient", frame, frame * sizeof(Color), [] {
+            canvas.fill(LinearGradient({Color::red, Color::yellow, Color::blue}), LinearGradient::Type::LeftToRight);
+        }});
+
+        for (size_t size : {16, 256, 1024}) {
+            const auto extent = static_cast<float>(size);
+            const auto area = static_cast<double>((size + 1) * (size + 1));
+            const string suffix = "/" + to_string(size);
+            result.push_back({"rectangle" + suffix, area, area * sizeof(Color), [extent] {
+                canvas.addFilledRectangle({100, 20}, {100 + extent, 20 + extent}, Color::red);
+            }});
+            result.push_back({"ellipse" + suffix, area * M_PI / 4.0, area * M_PI / 4.0 * sizeof(Color), [extent] {
+                canvas.addFilledEllipse({100, 20}, {100 + extent, 20 + extent}, Color::yellow);
+            }});
+            result.push_back({"ellipse-aa" + suffix, area * M_PI / 4.0, area * M_PI / 4.0 * sizeof(Color), [extent] {
+                canvas.setAntialiasing(true).addFilledEllipse({100, 20}, {100 + extent, 20 + extent}, Color::yellow)
+                      .setAntialiasing(false);
+            }});
+            result.push_back({"ellipse-gradient" + suffix, area * M_PI / 4.0, area * M_PI / 4.0 * sizeof(Color), [extent] {
+                canvas.addFilledEllipse({100, 20}, {100 + extent, 20 + extent}, LinearGradient({Color::red, Color::blue}));
+            }});
+            result.push_back({"line" + suffix, extent + 1.0, (extent + 1.0) * sizeof(Color), [extent] {
+                canvas.addLine({100, 20}, {100 + extent, 20 + extent / 3.0f}, Color::black);
+            }});
+            result.push_back({"line-wide" + suffix, 0.0, 0.0, [extent] {
+                canvas.addLine({100, 20}, {100 + extent, 20 + extent / 3.0f}, Color::black, Stroke(5.0f, Stroke::Cap::Round));
+            }});
+        }
+
+        for (size_t x = 0; x < width; x += 7) {
+            image.setSpan(static_cast<int64_t>(x % height), 0, static_cast<int64_t>(x), Color(Color::Hsl(x % 360, 80, 50)));
+        }
+        const double bytes24 = static_cast<double>(((width * 3 + 3) & ~static_cast<size_t>(3)) * height);
+        const double bytes32 = frame * 4.0;
+        const string path24 = directory + "/sglib-bench-24.bmp";
+        const string path32 = directory + "/sglib-bench-32.bmp";
+        // The decoders read these whether or not the encoders run.
+        Bitmap24(path24).write(image);
+        Bitmap32(path32).write(image);
+        result.push_back({"bmp/encode24", frame, bytes24, [path24] {
+            Bitmap24 bitmap(path24);
+            bitmap.write(image);
+        }});
+        result.push_back({"bmp/encode32", frame, bytes32, [path32] {
+            Bitmap32 bitmap(path32);
+            bitmap.write(image);
+        }});
+        result.push_back({"bmp/decode24", frame, bytes24, [path24] {
+            Bitmap24 bitmap(path24);
+            bitmap.read();
+            sink = bitmap.getPixels().get(1, 1).r();
+        }});
+        result.push_back({"bmp/decode32", frame, bytes32, [path32] {
+            Bitmap32 bitmap(path32);
+            bitmap.read();
+            sink = bitmap.getPixels().get(1, 1).r();
+        }});
+
+        result.push_back({"convert/rgba32-rgb24", frame, frame * sizeof(Color), [] {
+            RgbPixels converted = image.convert<Rgb24>();
+            sink = converted.get(1, 1).red;
+        }});
+        result.push_back({"convert/rgba32-gray8", frame, frame * sizeof(Color), [] {
+            GrayPixels converted = image.convert<Gray8>();
+            sink = converted.get(1, 1);
+        }});
+        result.push_back({"convert/hsl-rgb", 360.0, 0.0, [] {
+            for (uint16_t hue = 0; hue < 360; hue++) {
+                sink = Color(Color::Hsl(hue, 70, 40)).r();
+            }
+        }});
+        result.push_back({"convert/hex-rgb", 1.0, 0.0, [] {
+            sink = Color("#4295f5").b();
+        }});
+        return result;
+    }
+
+    void usage() {
+        cerr << "usage: bench [--filter SUBSTRING] [--repetitions N] [--min-time SECONDS] [--json PATH]\n"
+                "             [--tmp DIRECTORY]\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    string directory = filesystem::temp_directory_path().string();
+    for (int i = 1; i < argc; i++) {
+        const string argument = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        const string value = argv[++i];
+        try {
+            if (argument == "--filter") {
+                options.filter = value;
+            } else if (argument == "--repetitions") {
+                options.repetitions = max<size_t>(1, stoul(value));
+            } else if (argument == "--min-time") {
+                options.minimalTime = stod(value);
+            } else if (argument == "--json") {
+                options.json = value;
+            } else if (argument == "--tmp") {
+                directory = value;
+            } else {
+                usage();
+                return 2;
+            }
+        } catch (const logic_error&) {
+            usage();
+            return 2;
+        }
+    }
+
+    vector<Result> results;
+    fprintf(stderr, "%-26s %14s %12s %18s %18s\n", "benchmark", "ns/op", "stddev", "pixels/s", "bytes/s");
+    for (const auto& benchmark : benchmarks(directory)) {
+        if (benchmark.name.find(options.filter) == string::npos) {
+            continue;
+        }
+        results.push_back(run(benchmark, options));
+        const Result& result = results.back();
+        fprintf(stderr, "%-26s %14.1f %11.1f%% %18s %18s\n", result.name.c_str(), result.mean,
+                result.mean > 0.0 ? result.deviation / result.mean * 100.0 : 0.0,
+                rate(result.pixelsPerSecond, "px").c_str(), rate(result.bytesPerSecond, "B").c_str());
+    }
+    filesystem::remove(directory + "/sglib-bench-24.bmp");
+    filesystem::remove(directory + "/sglib-bench-32.bmp");
+
+    if (options.json == "-") {
+        writeJson(cout, results, options);
+    } else if (!options.json.empty()) {
+        ofstream out(options.json);
+        if (!out) {
+            cerr << "cannot write " << options.json << "\n";
+            return 1;
+        }
+        writeJson(out, results, options);
+    }
+    return 0;
+}
@@ -0,0 +1,337 @@
+#include "Canvas.h"
+#include "Executor.h"
+#include "Scene.h"
+#include "Sequence.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace sglib;
+
+namespace {
+    int failures = 0;
+
+    void check(bool condition, const char* test, const char* what) {
+        if (!condition) {
+            fprintf(stderr, "%s: %s\n", test, what);
+            failures++;
+        }
+    }
+
+    bool same(const Color& left, const Color& right) {
+        return left.r() == right.r() && left.g() == right.g() && left.b() == right.b() && left.a() == right.a();
+    }
+
+    // Saving a layer checkpoints its dirty rows, which must not hide what it holds from merge().
+    void mergeAfterDraw() {
+        const string path = (filesystem::temp_directory_path() / "sglib-canvas-test-layer.bmp").string();
+        Canvas canvas(64, 64);
+        Canvas layer = canvas.layer();
+        layer.addFilledRectangle({8, 8}, {40, 40}, Color::red);
+        layer.draw(path);
+        canvas.merge(layer);
+        filesystem::remove(path);
+        check(same(canvas.get().get(20, 20), Color::red), "mergeAfterDraw", "layer contents were dropped");
+        check(same(canvas.get().get(50, 50), Color::white), "mergeAfterDraw", "undrawn rows were changed");
+    }
+
+    // A lattice of single-pixel walls keeps hundreds of runs per row waiting, more than the flood
+    // fill's run stack holds; the overflow must still be filled, and nothing past a solid wall.
+    void floodFillLattice() {
+        const size_t size = 512;
+        const size_t wall = 401;
+        Canvas canvas(size, size);
+        for (size_t y = 1; y < size; y += 2) {
+            for (size_t x = 1; x < size; x += 2) {
+                canvas.get().set(x, y, Color::black);
+            }
+        }
+        for (size_t x = 0; x < size; x++) {
+            canvas.get().set(x, wall, Color::black);
+        }
+        canvas.floodFill({0, 0}, Color::red);
+        bool filled = true, walls = true, beyond = true;
+        for (size_t y = 0; y < size; y++) {
+            for (size_t x = 0; x < size; x++) {
+                const Color& value = canvas.get().get(x, y);
+                if (y == wall || (x % 2 == 1 && y % 2 == 1)) {
+                    walls = walls && same(value, Color::black);
+                } else if (y < wall) {
+                    filled = filled && same(value, Color::red);
+                } else {
+                    beyond = beyond && same(value, Color::white);
+                }
+            }
+        }
+        check(filled, "floodFillLattice", "part of the region was not filled");
+        check(walls, "floodFillLattice", "a wall was painted");
+        check(beyond, "floodFillLattice", "the fill crossed a wall");
+    }
+
+    // Runs the first task late on a thread of its own and refuses the rest.
+    class RefusingExecutor : public Executor {
+    public:
+        vector<thread> threads;
+
+        void submit(function<void()> task) override {
+            if (!threads.empty()) {
+                throw runtime_error("refused");
+            }
+            threads.emplace_back([task] {
+                this_thread::sleep_for(chrono::milliseconds(20));
+                task();
+            });
+        }
+
+        size_t concurrency() const override {
+            return 4;
+        }
+    };
+
+    // A band that was submitted reads parallelFor's locals, so it must be done before submit()'s
+    // exception leaves.
+    void parallelForRefused() {
+        auto executor = make_shared<RefusingExecutor>();
+        Executor::set(executor);
+        atomic<size_t> covered{0};
+        try {
+            Executor::parallelFor(0, 1024, Executor::parallelThreshold, [&](size_t first, size_t last) {
+                covered += last - first;
+            });
+            check(false, "parallelForRefused", "submit's exception was lost");
+        } catch (const runtime_error& error) {
+            check(string(error.what()) == "refused", "parallelForRefused", "another exception was thrown");
+        }
+        check(covered == 256, "parallelForRefused", "the submitted band had not finished");
+        Executor::set(nullptr);
+        for (auto& worker : executor->threads) {
+            worker.join();
+        }
+    }
+
+    const char* const sceneText =
+        "scene 96 64 #4295f5\n"
+        "antialias on\n"
+        "fill gradient up-to-bottom #461061 #31096e #110326\n"
+        "filled-rectangle 0 0 96 20 #17a607\n"
+        "filled-ellipse 30 10 80 50 #63d656c0 transform 1 0 0.5 1 0 0\n"
+        "line 0 0 90 60 blue width 3 cap round\n"
+        "clip 4 4 92 60\n"
+        "filled-polygon red rule even-odd points 10 10 60 10 30 50\n"
+        "path black width 2 data M 10 10 C 20 50 50 50 60 10 Z\n"
+        "unclip\n"
+        "flood-fill 2 62 yellow tolerance 8\n"
+        "text 20 30 black scale 2 \"hello\"\n";
+
+    string encode(const Scene& scene, Scene::Format format) {
+        ostringstream out;
+        scene.write(out, format);
+        return out.str();
+    }
+
+    bool sameRender(const Scene& left, const Scene& right) {
+        Canvas first = left.render(Pixels::Storage::Contiguous);
+        Canvas second = right.render(Pixels::Storage::Contiguous);
+        for (size_t y = 0; y < first.height(); y++) {
+            for (size_t x = 0; x < first.width(); x++) {
+                if (!same(first.get().get(x, y), second.get().get(x, y))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // The binary form must hold everything the text form says.
+    void sceneRoundTrip() {
+        const Scene scene = Scene::read(sceneText);
+        const string binary = encode(scene, Scene::Format::Binary);
+        const Scene decoded = Scene::read(binary);
+        check(encode(decoded, Scene::Format::Text) == encode(scene, Scene::Format::Text), "sceneRoundTrip",
+              "the text written back differs");
+        check(encode(decoded, Scene::Format::Binary) == binary, "sceneRoundTrip", "the binary written back differs");
+        check(sameRender(scene, decoded), "sceneRoundTrip", "the decoded scene renders differently");
+    }
+
+    // Every cut of a binary scene is refused, and so are bad ops and counts past the end.
+    void sceneCorrupt() {
+        const string binary = encode(Scene::read(sceneText), Scene::Format::Binary);
+        bool refused = true;
+        for (size_t size = 4; size < binary.size(); size++) {
+            try {
+                Scene::read(binary.substr(0, size));
+                refused = false;
+            } catch (const runtime_error&) {
+            }
+        }
+        check(refused, "sceneCorrupt", "a truncated scene was read");
+        // Signature, version, width 96, height 64 and the background, then the command count.
+        const size_t commands = 4 + 1 + 1 + 1 + sizeof(Color);
+        string badOp = binary;
+        badOp[commands + 1] = static_cast<char>(200);
+        string badCount = binary.substr(0, commands) + "\x80\x80\x80\x20";
+        for (const string* data : {&badOp, &badCount}) {
+            try {
+                Scene::read(*data);
+                check(false, "sceneCorrupt", "a corrupt scene was read");
+            } catch (const runtime_error&) {
+            }
+        }
+        // Whatever a flipped byte turns into, reading it either fails cleanly or gives a scene.
+        for (size_t i = 4; i < binary.size(); i++) {
+            string flipped = binary;
+            flipped[i] = static_cast<char>(flipped[i] ^ 0xa5);
+            try {
+                Scene::read(flipped);
+            } catch (const exception&) {
+            }
+        }
+    }
+
+    // Reads every frame of a delta stream, returning how many there were.
+    size_t readDelta(const string& path, vector<vector<Color::Rgb>>* frames = nullptr) {
+        DeltaReader reader(path);
+        size_t count = 0;
+        for (; reader.next(); count++) {
+            if (frames != nullptr) {
+                vector<Color::Rgb> pixels;
+                for (size_t y = 0; y < reader.height(); y++) {
+                    for (size_t x = 0; x < reader.width(); x++) {
+                        pixels.push_back(reader.frame().get(x, y));
+                    }
+                }
+                frames->push_back(pixels);
+            }
+        }
+        return count;
+    }
+
+    void writeFile(const string& path, const string& data) {
+        ofstream file(path, ios::binary);
+        file.write(data.data(), static_cast<streamsize>(data.size()));
+    }
+
+    // DeltaReader must give back every frame FrameSequence::delta() was handed, and refuse the
+    // stream when it is cut short or its ranges point outside the frame.
+    void deltaRoundTrip() {
+        const string path = (filesystem::temp_directory_path() / "sglib-canvas-test.sgd").string();
+        const string damaged = path + ".damaged";
+        const size_t width = 40, height = 30, count = 9;
+        FrameSequence::Options options;
+        options.start = FrameSequence::Start::Previous;
+        options.keyframeInterval = 4;
+        vector<vector<Color::Rgb>> expected;
+        {
+            FrameSequence sequence = FrameSequence::delta(width, height, path, Color::white, options);
+            for (size_t frame = 0; frame < count; frame++) {
+                Canvas& canvas = sequence.begin();
+                const auto x = static_cast<float>(frame * 3);
+                canvas.addFilledEllipse({x, 4}, {x + 9, 13}, frame % 2 == 0 ? Color::red : Color::blue);
+                if (frame == 5) {
+                    canvas.addFilledRectangle({0, 20}, {39, 29}, Color::green);
+                }
+                vector<Color::Rgb> pixels;
+                for (size_t y = 0; y < height; y++) {
+                    for (size_t x = 0; x < width; x++) {
+                        const Color& value = canvas.get().get(x, y);
+                        pixels.push_back(Color::Rgb(value.r(), value.g(), value.b()));
+                    }
+                }
+                expected.push_back(pixels);
+                sequence.commit();
+            }
+            sequence.finish();
+        }
+
+        vector<vector<Color::Rgb>> frames;
+        try {
+            readDelta(path, &frames);
+        } catch (const exception& error) {
+            check(false, "deltaRoundTrip", error.what());
+        }
+        bool matching = frames.size() == expected.size();
+        for (size_t frame = 0; matching && frame < frames.size(); frame++) {
+            for (size_t i = 0; i < frames[frame].size(); i++) {
+                const Color::Rgb& left = frames[frame][i];
+                const Color::Rgb& right = expected[frame][i];
+                matching = matching && left.red == right.red && left.green == right.green && left.blue == right.blue;
+            }
+        }
+        check(matching, "deltaRoundTrip", "the frames read back differ");
+
+        ifstream file(path, ios::binary);
+        const string stream((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        file.close();
+        // Cut between frames, a stream just ends early; anywhere else it is refused.
+        bool refused = true;
+        for (size_t size = 0; size < stream.size(); size++) {
+            writeFile(damaged, stream.substr(0, size));
+            try {
+                refused = refused && readDelta(damaged) < count;
+            } catch (const runtime_error&) {
+            }
+        }
+        check(refused, "deltaRoundTrip", "a truncated stream read whole");
+        // Signature, version, width and height; then the keyframe flag, the range count and the
+        // first range, whose y goes past the bottom.
+        const size_t header = 4 + 1 + 4 + 4;
+        string notKey = stream;
+        notKey[header] = 0;
+        string outside = stream;
+        const uint32_t below = height;
+        memcpy(&outside[header + 1 + 4], &below, sizeof(below));
+        for (const string* data : {&notKey, &outside}) {
+            writeFile(damaged, *data);
+            try {
+                readDelta(damaged);
+                check(false, "deltaRoundTrip", "a corrupt stream was read");
+            } catch (const runtime_error&) {
+            }
+        }
+        filesystem::remove(path);
+        filesystem::remove(damaged);
+    }
+
+    // Scenes clear the canvas they are given, which may have no rows or no columns, and sgrender
+    // then encodes it.
+    void renderEmpty() {
+        const size_t sizes[][2] = {{0, 0}, {0, 7}, {7, 0}};
+        for (const auto& size : sizes) {
+            try {
+                Canvas canvas(size[0], size[1], Color::white, Pixels::Storage::Contiguous);
+                canvas.clear(Color::black);
+                Scene::read("scene " + to_string(size[0]) + " " + to_string(size[1]) + " white\n").render(canvas);
+                ostringstream out;
+                canvas.draw(out);
+                canvas.draw(out, Bitmap::Type::bit32);
+            } catch (const exception& error) {
+                check(false, "renderEmpty", error.what());
+            }
+        }
+    }
+}
+
+int main() {
+    mergeAfterDraw();
+    floodFillLattice();
+    parallelForRefused();
+    sceneRoundTrip();
+    sceneCorrupt();
+    deltaRoundTrip();
+    renderEmpty();
+    if (failures != 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include "Bitmap.h"
+#include "Sequence.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+using namespace std;
+using namespace sglib;
+
+namespace {
+    void usage() {
+        fprintf(stderr, "usage: sgplay STREAM [OUTPUT]\n"
+                        "  decodes a delta stream written by FrameSequence::delta(), writing every frame\n"
+                        "  to OUTPUT/frameNNNNN.bmp when OUTPUT is given, and reports the decoding rate\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        usage();
+        return 2;
+    }
+    try {
+        const auto start = chrono::steady_clock::now();
+        DeltaReader reader(argv[1]);
+        const string output = argc == 3 ? argv[2] : "";
+        if (!output.empty()) {
+            filesystem::create_directories(output);
+        }
+        size_t frames = 0;
+        while (reader.next()) {
+            frames++;
+            if (!output.empty()) {
+                char name[32];
+                snprintf(name, sizeof(name), "frame%05zu.bmp", reader.index());
+                Bitmap24((filesystem::path(output) / name).string()).write(reader.frame());
+            }
+        }
+        const double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        printf("%zu frames of %zux%zu, %.3f s, %.1f frames/s\n", frames, reader.width(), reader.height(), elapsed,
+               elapsed > 0.0 ? static_cast<double>(frames) / elapsed : 0.0);
+        return 0;
+    } catch (const exception& error) {
+        fprintf(stderr, "sgplay: %s\n", error.what());
+        return 1;
+    }
+}
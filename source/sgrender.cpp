@@ -0,0 +1,228 @@
+#include "Canvas.h"
+#include "Executor.h"
+#include "Scene.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace sglib;
+
+namespace {
+    class Options {
+    public:
+        string output = ".";
+        size_t jobs = 0;
+        bool compile = false;
+        Bitmap::Type type = Bitmap::Type::bit24;
+    };
+
+    class Totals {
+    public:
+        size_t scenes = 0;
+        size_t failed = 0;
+        double pixels = 0.0;
+        double loading = 0.0;
+        double rendering = 0.0;
+        double encoding = 0.0;
+    };
+
+    using Clock = chrono::steady_clock;
+
+    double seconds(Clock::time_point start) {
+        return chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    bool isScene(const filesystem::path& path) {
+        return path.extension() == ".scene" || path.extension() == ".sgb";
+    }
+
+    // A directory contributes its scene files in name order, a scene file itself, and anything
+    // else is a manifest listing one path per line, relative to the manifest, # for comments.
+    void collect(const filesystem::path& input, vector<filesystem::path>& scenes) {
+        if (filesystem::is_directory(input)) {
+            vector<filesystem::path> found;
+            for (const auto& entry : filesystem::directory_iterator(input)) {
+                if (entry.is_regular_file() && isScene(entry.path())) {
+                    found.push_back(entry.path());
+                }
+            }
+            sort(found.begin(), found.end());
+            scenes.insert(scenes.end(), found.begin(), found.end());
+        } else if (isScene(input)) {
+            scenes.push_back(input);
+        } else {
+            ifstream manifest(input);
+            if (!manifest.is_open()) {
+                throw runtime_error("failed to open " + input.string());
+            }
+            string line;
+            while (getline(manifest, line)) {
+                line.erase(line.find_last_not_of(" \t\r") + 1);
+                if (line.empty() || line[0] == '#') {
+                    continue;
+                }
+                const filesystem::path path(line);
+                collect(path.is_absolute() ? path : input.parent_path() / path, scenes);
+            }
+        }
+    }
+
+    void usage() {
+        fprintf(stderr, "usage: sgrender [--jobs N] [--output DIR] [--bit32] [--compile] INPUT...\n"
+                        "  INPUT is a .scene or .sgb file, a directory of them, or a manifest listing them\n"
+                        "  --jobs     scenes rendered at once, one per hardware thread by default\n"
+                        "  --output   where the images go, named after the scenes, which must differ (default .)\n"
+                        "  --bit32    writes 32-bit instead of 24-bit bitmaps\n"
+                        "  --compile  writes each scene in the binary form (.sgb) instead of rendering it\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    vector<filesystem::path> inputs;
+    for (int i = 1; i < argc; i++) {
+        const string argument = argv[i];
+        if (argument == "--bit32") {
+            options.type = Bitmap::Type::bit32;
+        } else if (argument == "--compile") {
+            options.compile = true;
+        } else if (argument == "--jobs" || argument == "--output") {
+            if (i + 1 >= argc) {
+                usage();
+                return 2;
+            }
+            const string value = argv[++i];
+            if (argument == "--jobs") {
+                try {
+                    options.jobs = stoul(value);
+                } catch (const logic_error&) {
+                    usage();
+                    return 2;
+                }
+            } else {
+                options.output = value;
+            }
+        } else if (argument.rfind("--", 0) == 0) {
+            usage();
+            return 2;
+        } else {
+            inputs.emplace_back(argument);
+        }
+    }
+    if (inputs.empty()) {
+        usage();
+        return 2;
+    }
+
+    vector<filesystem::path> scenes;
+    try {
+        for (const auto& input : inputs) {
+            collect(input, scenes);
+        }
+        // Outputs are named after the scenes alone, so two scenes of one name would overwrite
+        // each other's.
+        map<filesystem::path, filesystem::path> named;
+        for (const auto& path : scenes) {
+            const auto found = named.emplace(path.stem(), path);
+            if (!found.second) {
+                throw runtime_error(found.first->second.string() + " and " + path.string() +
+                                    " would both be written to " + path.stem().string() +
+                                    (options.compile ? ".sgb" : ".bmp"));
+            }
+        }
+        filesystem::create_directories(options.output);
+    } catch (const exception& error) {
+        fprintf(stderr, "sgrender: %s\n", error.what());
+        return 1;
+    }
+    if (options.jobs == 0) {
+        options.jobs = max(1u, thread::hardware_concurrency());
+    }
+    options.jobs = min(options.jobs, max<size_t>(1, scenes.size()));
+    // Scenes already keep every core busy; splitting each one into row bands on top of that
+    // would only add hand-offs.
+    if (options.jobs > 1) {
+        Executor::set(make_shared<ThreadPool>(1));
+    }
+
+    atomic<size_t> next(0);
+    mutex merging;
+    Totals totals;
+    auto work = [&] {
+        Totals local;
+        // Kept between scenes of the same size, so its pixels are cleared instead of reallocated.
+        unique_ptr<Canvas> canvas;
+        for (size_t index = next++; index < scenes.size(); index = next++) {
+            const filesystem::path& path = scenes[index];
+            try {
+                auto start = Clock::now();
+                const Scene scene = Scene::load(path.string());
+                local.loading += seconds(start);
+                if (options.compile) {
+                    start = Clock::now();
+                    scene.save((filesystem::path(options.output) / path.stem()).string() + ".sgb",
+                               Scene::Format::Binary);
+                    local.encoding += seconds(start);
+                    local.scenes++;
+                    continue;
+                }
+                if (canvas == nullptr || canvas->width() != scene.width() || canvas->height() != scene.height()) {
+                    canvas.reset(new Canvas(scene.width(), scene.height(), scene.background(),
+                                            Pixels::Storage::Contiguous));
+                }
+                start = Clock::now();
+                scene.render(*canvas);
+                local.rendering += seconds(start);
+                start = Clock::now();
+                canvas->draw((filesystem::path(options.output) / path.stem()).string() + ".bmp", options.type);
+                local.encoding += seconds(start);
+                local.scenes++;
+                local.pixels += static_cast<double>(scene.width() * scene.height());
+            } catch (const exception& error) {
+                // The canvas may be left with the scene's clips or half drawn.
+                canvas.reset();
+                local.failed++;
+                lock_guard<mutex> lock(merging);
+                fprintf(stderr, "sgrender: %s: %s\n", path.string().c_str(), error.what());
+            }
+        }
+        lock_guard<mutex> lock(merging);
+        totals.scenes += local.scenes;
+        totals.failed += local.failed;
+        totals.pixels += local.pixels;
+        totals.loading += local.loading;
+        totals.rendering += local.rendering;
+        totals.encoding += local.encoding;
+    };
+
+    const auto start = Clock::now();
+    vector<thread> workers;
+    for (size_t i = 1; i < options.jobs; i++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    const double elapsed = seconds(start);
+
+    printf("%zu scenes, %zu failed, %zu jobs, %.3f s\n", totals.scenes, totals.failed, options.jobs, elapsed);
+    if (elapsed > 0.0) {
+        printf("%.1f scenes/s, %.1f Mpixels/s\n", static_cast<double>(totals.scenes) / elapsed,
+               totals.pixels / elapsed / 1e6);
+    }
+    printf("thread time: %.3f s loading, %.3f s rendering, %.3f s %s\n", totals.loading, totals.rendering,
+           totals.encoding, options.compile ? "compiling" : "encoding");
+    return totals.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,220 @@
+#include "RenderProtocol.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace sglib;
+
+namespace {
+    using Clock = chrono::steady_clock;
+
+    class Options {
+    public:
+        string socket = protocol::defaultSocket;
+        size_t connections = 1;
+        size_t requests = 100;
+        // Requests each connection keeps in flight.
+        size_t pipeline = 4;
+        protocol::Request kind = protocol::Request::Render24;
+        string output;
+        bool stats = false;
+        string scene;
+    };
+
+    class Totals {
+    public:
+        size_t answered = 0;
+        size_t failed = 0;
+        double bytes = 0.0;
+        vector<double> latencies;
+        string firstError;
+    };
+
+    string query(const string& socket) {
+        const int connection = protocol::connect(socket);
+        uint8_t kind = 0;
+        string payload;
+        const bool answered = protocol::writeFrame(connection, static_cast<uint8_t>(protocol::Request::Stats), "") &&
+                              protocol::readFrame(connection, kind, payload);
+        close(connection);
+        if (!answered) {
+            throw runtime_error("no answer from " + socket);
+        }
+        return payload;
+    }
+
+    double percentile(const vector<double>& sorted, double fraction) {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+        return sorted[min(sorted.size() - 1, static_cast<size_t>(fraction * static_cast<double>(sorted.size())))];
+    }
+
+    void usage() {
+        fprintf(stderr, "usage: sgrender_client [--socket PATH] [--connections N] [--requests N] [--pipeline N]\n"
+                        "                       [--bit32] [--output FILE] SCENE\n"
+                        "       sgrender_client [--socket PATH] --stats\n"
+                        "  sends SCENE --requests times over --connections connections, each keeping\n"
+                        "  --pipeline requests in flight, and reports throughput and latency;\n"
+                        "  --output keeps the first bitmap received, --stats prints the daemon counters\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const string argument = argv[i];
+        if (argument == "--bit32") {
+            options.kind = protocol::Request::Render32;
+        } else if (argument == "--stats") {
+            options.stats = true;
+        } else if (argument.rfind("--", 0) == 0) {
+            if (i + 1 >= argc) {
+                usage();
+                return 2;
+            }
+            const string value = argv[++i];
+            try {
+                if (argument == "--socket") {
+                    options.socket = value;
+                } else if (argument == "--connections") {
+                    options.connections = max<size_t>(1, stoul(value));
+                } else if (argument == "--requests") {
+                    options.requests = stoul(value);
+                } else if (argument == "--pipeline") {
+                    options.pipeline = max<size_t>(1, stoul(value));
+                } else if (argument == "--output") {
+                    options.output = value;
+                } else {
+                    usage();
+                    return 2;
+                }
+            } catch (const logic_error&) {
+                usage();
+                return 2;
+            }
+        } else {
+            options.scene = argument;
+        }
+    }
+    try {
+        if (options.stats) {
+            printf("%s\n", query(options.socket).c_str());
+            return 0;
+        }
+        if (options.scene.empty()) {
+            usage();
+            return 2;
+        }
+        ifstream file(options.scene, ios::binary);
+        if (!file.is_open()) {
+            throw runtime_error("failed to open " + options.scene);
+        }
+        const string scene((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        if (scene.size() > protocol::maximumFrame) {
+            throw runtime_error(options.scene + " is larger than the frame limit");
+        }
+
+        atomic<size_t> next(0);
+        mutex merging;
+        Totals totals;
+        auto run = [&] {
+            Totals local;
+            const int connection = protocol::connect(options.socket);
+            deque<Clock::time_point> inFlight;
+            auto send = [&] {
+                if (next++ >= options.requests) {
+                    return false;
+                }
+                inFlight.push_back(Clock::now());
+                if (!protocol::writeFrame(connection, static_cast<uint8_t>(options.kind), scene)) {
+                    throw runtime_error("connection lost");
+                }
+                return true;
+            };
+            while (inFlight.size() < options.pipeline && send()) { }
+            uint8_t kind = 0;
+            string payload;
+            while (!inFlight.empty()) {
+                if (!protocol::readFrame(connection, kind, payload)) {
+                    throw runtime_error("connection lost");
+                }
+                local.latencies.push_back(chrono::duration<double, micro>(Clock::now() - inFlight.front()).count());
+                inFlight.pop_front();
+                if (kind == static_cast<uint8_t>(protocol::Response::Bitmap)) {
+                    local.answered++;
+                    local.bytes += static_cast<double>(payload.size());
+                    lock_guard<mutex> lock(merging);
+                    if (!options.output.empty()) {
+                        ofstream(options.output, ios::binary).write(payload.data(), static_cast<streamsize>(payload.size()));
+                        options.output.clear();
+                    }
+                } else {
+                    local.failed++;
+                    if (local.firstError.empty()) {
+                        local.firstError = payload;
+                    }
+                }
+                send();
+            }
+            close(connection);
+            lock_guard<mutex> lock(merging);
+            totals.answered += local.answered;
+            totals.failed += local.failed;
+            totals.bytes += local.bytes;
+            totals.latencies.insert(totals.latencies.end(), local.latencies.begin(), local.latencies.end());
+            if (totals.firstError.empty()) {
+                totals.firstError = local.firstError;
+            }
+        };
+
+        const auto start = Clock::now();
+        vector<thread> clients;
+        vector<string> errors(options.connections);
+        for (size_t i = 0; i < options.connections; i++) {
+            clients.emplace_back([&, i] {
+                try {
+                    run();
+                } catch (const exception& error) {
+                    errors[i] = error.what();
+                }
+            });
+        }
+        for (auto& client : clients) {
+            client.join();
+        }
+        const double elapsed = chrono::duration<double>(Clock::now() - start).count();
+        for (const auto& error : errors) {
+            if (!error.empty()) {
+                throw runtime_error(error);
+            }
+        }
+
+        sort(totals.latencies.begin(), totals.latencies.end());
+        printf("%zu answered, %zu failed, %zu connections x %zu in flight, %.3f s\n", totals.answered, totals.failed,
+               options.connections, options.pipeline, elapsed);
+        if (!totals.firstError.empty()) {
+            printf("first error: %s\n", totals.firstError.c_str());
+        }
+        printf("%.1f requests/s, %.1f MB/s\n", static_cast<double>(totals.latencies.size()) / elapsed,
+               totals.bytes / elapsed / 1e6);
+        printf("latency us: p50 %.0f, p90 %.0f, p99 %.0f, max %.0f\n", percentile(totals.latencies, 0.5),
+               percentile(totals.latencies, 0.9), percentile(totals.latencies, 0.99),
+               totals.latencies.empty() ? 0.0 : totals.latencies.back());
+        printf("daemon: %s\n", query(options.socket).c_str());
+        return totals.failed == 0 ? 0 : 1;
+    } catch (const exception& error) {
+        fprintf(stderr, "sgrender_client: %s\n", error.what());
+        return 1;
+    }
+}
@@ -0,0 +1,588 @@
+#include "Canvas.h"
+#include "Executor.h"
+#include "RenderProtocol.h"
+#include "Scene.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace sglib;
+
+namespace {
+    using Clock = chrono::steady_clock;
+
+    class Options {
+    public:
+        string socket = protocol::defaultSocket;
+        size_t workers = 0;
+        // Requests waiting for a worker; once full, connections stop reading until there is room.
+        size_t queue = 256;
+        // Requests a worker takes at once, rendered together so same-sized scenes share a canvas.
+        size_t batch = 8;
+        // Idle canvases kept per scene size, and bytes of them kept in all.
+        size_t pooled = 4;
+        uint64_t poolBytes = 256 << 20;
+        // Bytes of pixels and temporaries in use at once; scenes that would need more, even with
+        // the idle canvases freed, are answered with an Error instead of being rendered.
+        uint64_t memory = MemoryBudget::unlimited;
+    };
+
+    atomic<bool> stopping(false);
+
+    void stop(int) {
+        stopping = true;
+    }
+
+    class Counters {
+    public:
+        const Clock::time_point started = Clock::now();
+        atomic<uint64_t> connections{0}, requests{0}, completed{0}, failed{0}, batches{0}, batched{0};
+        atomic<uint64_t> bytesIn{0}, bytesOut{0}, poolHits{0}, poolMisses{0}, poolBytes{0}, maximumQueued{0};
+        atomic<uint64_t> maximumLatency{0};
+        // Bucket i counts responses that took [2^i, 2^(i+1)) microseconds from request to reply.
+        array<atomic<uint64_t>, 40> latency{};
+
+        void record(Clock::duration elapsed) {
+            const auto micros = static_cast<uint64_t>(max<int64_t>(1, chrono::duration_cast<chrono::microseconds>(elapsed).count()));
+            size_t bucket = 0;
+            while ((micros >> (bucket + 1)) != 0 && bucket + 1 < latency.size()) {
+                bucket++;
+            }
+            latency[bucket]++;
+            uint64_t seen = maximumLatency;
+            while (micros > seen && !maximumLatency.compare_exchange_weak(seen, micros)) { }
+        }
+
+        // The upper bound of the bucket holding the given fraction of responses.
+        uint64_t percentile(double fraction) const {
+            uint64_t total = 0;
+            for (const auto& bucket : latency) {
+                total += bucket;
+            }
+            uint64_t seen = 0;
+            for (size_t i = 0; i < latency.size(); i++) {
+                seen += latency[i];
+                if (total > 0 && static_cast<double>(seen) >= fraction * static_cast<double>(total)) {
+                    return min<uint64_t>(maximumLatency, (uint64_t(2) << i) - 1);
+                }
+            }
+            return 0;
+        }
+
+        string json(size_t queued) const {
+            const double uptime = chrono::duration<double>(Clock::now() - started).count();
+            ostringstream out;
+            out << "{\"uptime_seconds\": " << uptime
+                << ", \"connections\": " << connections
+                << ", \"requests\": " << requests
+                << ", \"completed\": " << completed
+                << ", \"failed\": " << failed
+                << ", \"queued\": " << queued
+                << ", \"max_queued\": " << maximumQueued
+                << ", \"batches\": " << batches
+                << ", \"average_batch\": " << (batches > 0 ? static_cast<double>(batched) / static_cast<double>(batches) : 0.0)
+                << ", \"bytes_in\": " << bytesIn
+                << ", \"bytes_out\": " << bytesOut
+                << ", \"pool_hits\": " << poolHits
+                << ", \"pool_misses\": " << poolMisses
+                << ", \"pool_bytes\": " << poolBytes
+                << ", \"completed_per_second\": " << (uptime > 0.0 ? static_cast<double>(completed) / uptime : 0.0)
+                << ", \"memory_bytes\": {\"live\": " << MemoryBudget::process().live()
+                << ", \"peak\": " << MemoryBudget::process().peak()
+                << ", \"limit\": " << MemoryBudget::process().limit() << "}"
+                << ", \"latency_us\": {\"p50\": " << percentile(0.5)
+                << ", \"p90\": " << percentile(0.9)
+                << ", \"p99\": " << percentile(0.99)
+                << ", \"max\": " << maximumLatency << "}}";
+            return out.str();
+        }
+    };
+
+    class Connection;
+
+    class Job {
+    public:
+        protocol::Request kind;
+        string scene;
+        Clock::time_point received;
+        Connection* owner;
+        protocol::Response status = protocol::Response::Error;
+        string result;
+        bool done = false;
+    };
+
+    // Requests are read and answered on two threads, so a client can keep several in flight;
+    // answers go out in request order whatever order the workers finish in.
+    class Connection {
+    public:
+        int socket;
+        mutex lock;
+        condition_variable changed;
+        deque<shared_ptr<Job>> pending;
+        bool closed = false;
+        atomic<bool> finished{false};
+        thread reader, writer;
+
+        explicit Connection(int socket) : socket(socket) { }
+
+        void complete(Job& job, protocol::Response status, string result) {
+            lock_guard<mutex> guard(lock);
+            job.status = status;
+            job.result = move(result);
+            job.done = true;
+            changed.notify_all();
+        }
+    };
+
+    class Queue {
+    public:
+        explicit Queue(size_t capacity) : capacity(capacity) { }
+
+        // Blocks while the queue is full, which is what pushes back on clients.
+        void push(shared_ptr<Job> job, Counters& counters) {
+            unique_lock<mutex> guard(lock);
+            notFull.wait(guard, [this] { return jobs.size() < capacity || closed; });
+            jobs.push_back(move(job));
+            uint64_t seen = counters.maximumQueued;
+            while (jobs.size() > seen && !counters.maximumQueued.compare_exchange_weak(seen, jobs.size())) { }
+            notEmpty.notify_one();
+        }
+
+        // Up to `limit` jobs, or none once closed and drained.
+        vector<shared_ptr<Job>> take(size_t limit) {
+            unique_lock<mutex> guard(lock);
+            notEmpty.wait(guard, [this] { return !jobs.empty() || closed; });
+            vector<shared_ptr<Job>> batch;
+            while (!jobs.empty() && batch.size() < limit) {
+                batch.push_back(move(jobs.front()));
+                jobs.pop_front();
+            }
+            notFull.notify_all();
+            return batch;
+        }
+
+        void close() {
+            lock_guard<mutex> guard(lock);
+            closed = true;
+            notEmpty.notify_all();
+            notFull.notify_all();
+        }
+
+        size_t size() {
+            lock_guard<mutex> guard(lock);
+            return jobs.size();
+        }
+
+    private:
+        size_t capacity;
+        mutex lock;
+        condition_variable notEmpty, notFull;
+        deque<shared_ptr<Job>> jobs;
+        bool closed = false;
+    };
+
+    // Contiguous canvases, one pixel buffer each, handed from scene to scene so that rendering
+    // clears them in place instead of allocating. Once the idle ones take more than `capacity`
+    // bytes, those of the size used longest ago are freed first.
+    class CanvasPool {
+    public:
+        CanvasPool(size_t limit, uint64_t capacity, Counters& counters) :
+                limit(limit), capacity(capacity), counters(counters) { }
+
+        unique_ptr<Canvas> acquire(const Scene& scene) {
+            {
+                lock_guard<mutex> guard(lock);
+                const auto found = idle.find({scene.width(), scene.height()});
+                if (found != idle.end()) {
+                    unique_ptr<Canvas> canvas = take(found);
+                    counters.poolHits++;
+                    return canvas;
+                }
+            }
+            counters.poolMisses++;
+            while (true) {
+                try {
+                    return unique_ptr<Canvas>(new Canvas(scene.width(), scene.height(), scene.background(),
+                                                         Pixels::Storage::Contiguous));
+                } catch (const BudgetExceeded&) {
+                    // Idle canvases are charged to the budget too; the scene only fails once
+                    // freeing all of them has not made room for it.
+                    if (!evict()) {
+                        throw;
+                    }
+                }
+            }
+        }
+
+        // New canvases allocate their pixels on the first write, so the budget may only refuse
+        // them here; the scene is drawn again after each idle canvas freed to make room.
+        void render(const Scene& scene, Canvas& canvas) {
+            while (true) {
+                try {
+                    scene.render(canvas);
+                    return;
+                } catch (const BudgetExceeded&) {
+                    if (!evict()) {
+                        throw;
+                    }
+                }
+            }
+        }
+
+        void release(unique_ptr<Canvas> canvas) {
+            // Declared before the guard, so the canvases evicted are freed once it is unlocked.
+            vector<unique_ptr<Canvas>> evicted;
+            lock_guard<mutex> guard(lock);
+            const Size size(canvas->width(), canvas->height());
+            auto found = idle.find(size);
+            if (found == idle.end()) {
+                if (limit == 0) {
+                    return;
+                }
+                recency.push_front(size);
+                found = idle.emplace(size, Sized{recency.begin(), {}}).first;
+            } else {
+                recency.splice(recency.begin(), recency, found->second.used);
+            }
+            if (found->second.canvases.size() >= limit) {
+                return;
+            }
+            held += canvas->get().bytes();
+            found->second.canvases.push_back(move(canvas));
+            while (held > capacity) {
+                evicted.push_back(take(idle.find(recency.back())));
+            }
+            counters.poolBytes = held;
+        }
+
+    private:
+        using Size = pair<size_t, size_t>;
+
+        class Sized {
+        public:
+            list<Size>::iterator used;
+            vector<unique_ptr<Canvas>> canvases;
+        };
+
+        size_t limit;
+        uint64_t capacity;
+        Counters& counters;
+        mutex lock;
+        uint64_t held = 0;
+        map<Size, Sized> idle;
+        // Sizes with idle canvases, the one released most recently first.
+        list<Size> recency;
+
+        // Frees an idle canvas of the size used longest ago, if there is one.
+        bool evict() {
+            unique_ptr<Canvas> canvas;
+            lock_guard<mutex> guard(lock);
+            if (recency.empty()) {
+                return false;
+            }
+            canvas = take(idle.find(recency.back()));
+            return true;
+        }
+
+        // Removes the last canvas kept for a size, and the size once none are left.
+        unique_ptr<Canvas> take(map<Size, Sized>::iterator found) {
+            unique_ptr<Canvas> canvas = move(found->second.canvases.back());
+            found->second.canvases.pop_back();
+            held -= canvas->get().bytes();
+            if (found->second.canvases.empty()) {
+                recency.erase(found->second.used);
+                idle.erase(found);
+            }
+            counters.poolBytes = held;
+            return canvas;
+        }
+    };
+
+    class Server {
+    public:
+        explicit Server(const Options& options) : options(options), queue(options.queue),
+                                                  pool(options.pooled, options.poolBytes, counters) { }
+
+        void serve(int listener) {
+            for (size_t i = 0; i < options.workers; i++) {
+                workers.emplace_back(&Server::work, this);
+            }
+            while (!stopping) {
+                pollfd waiting{listener, POLLIN, 0};
+                if (poll(&waiting, 1, 200) <= 0) {
+                    reap();
+                    continue;
+                }
+                const int socket = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+                if (socket < 0) {
+                    continue;
+                }
+                counters.connections++;
+                connections.emplace_back(new Connection(socket));
+                Connection& connection = *connections.back();
+                connection.reader = thread(&Server::read, this, ref(connection));
+                connection.writer = thread(&Server::write, this, ref(connection));
+                reap();
+            }
+            // Clients get the answers to what they already sent, then the connections close.
+            for (auto& connection : connections) {
+                shutdown(connection->socket, SHUT_RD);
+            }
+            for (auto& connection : connections) {
+                connection->reader.join();
+                connection->writer.join();
+            }
+            connections.clear();
+            queue.close();
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+
+        string json() {
+            return counters.json(queue.size());
+        }
+
+    private:
+        Options options;
+        Counters counters;
+        Queue queue;
+        CanvasPool pool;
+        vector<thread> workers;
+        list<unique_ptr<Connection>> connections;
+
+        void reap() {
+            for (auto it = connections.begin(); it != connections.end();) {
+                if ((*it)->finished) {
+                    (*it)->reader.join();
+                    (*it)->writer.join();
+                    it = connections.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        void read(Connection& connection) {
+            uint8_t kind = 0;
+            string payload;
+            while (protocol::readFrame(connection.socket, kind, payload)) {
+                counters.requests++;
+                counters.bytesIn += payload.size() + 5;
+                auto job = make_shared<Job>();
+                job->kind = static_cast<protocol::Request>(kind);
+                job->scene = move(payload);
+                job->received = Clock::now();
+                job->owner = &connection;
+                {
+                    lock_guard<mutex> guard(connection.lock);
+                    connection.pending.push_back(job);
+                }
+                if (job->kind == protocol::Request::Stats) {
+                    connection.complete(*job, protocol::Response::Stats, json());
+                } else if (job->kind != protocol::Request::Render24 && job->kind != protocol::Request::Render32) {
+                    connection.complete(*job, protocol::Response::Error, "unknown request");
+                } else {
+                    queue.push(move(job), counters);
+                }
+                payload = string();
+            }
+            lock_guard<mutex> guard(connection.lock);
+            connection.closed = true;
+            connection.changed.notify_all();
+        }
+
+        void write(Connection& connection) {
+            bool broken = false;
+            while (true) {
+                shared_ptr<Job> job;
+                {
+                    unique_lock<mutex> guard(connection.lock);
+                    connection.changed.wait(guard, [&] {
+                        return (!connection.pending.empty() && connection.pending.front()->done) ||
+                               (connection.closed && connection.pending.empty());
+                    });
+                    if (connection.pending.empty()) {
+                        break;
+                    }
+                    job = move(connection.pending.front());
+                    connection.pending.pop_front();
+                }
+                // Once the client is gone the remaining answers are still waited for, since
+                // workers hold on to this connection until they are done, but not sent.
+                if (!broken) {
+                    broken = !protocol::writeFrame(connection.socket, static_cast<uint8_t>(job->status), job->result);
+                    if (broken) {
+                        shutdown(connection.socket, SHUT_RD);
+                    } else {
+                        counters.bytesOut += job->result.size() + 5;
+                    }
+                }
+                counters.record(Clock::now() - job->received);
+            }
+            close(connection.socket);
+            connection.finished = true;
+        }
+
+        void work() {
+            while (true) {
+                vector<shared_ptr<Job>> batch = queue.take(options.batch);
+                if (batch.empty()) {
+                    return;
+                }
+                counters.batches++;
+                counters.batched += batch.size();
+                vector<pair<Scene, Job*>> scenes;
+                for (auto& job : batch) {
+                    try {
+                        scenes.emplace_back(Scene::read(job->scene), job.get());
+                    } catch (const exception& error) {
+                        counters.failed++;
+                        job->owner->complete(*job, protocol::Response::Error, error.what());
+                    }
+                }
+                stable_sort(scenes.begin(), scenes.end(), [](const pair<Scene, Job*>& a, const pair<Scene, Job*>& b) {
+                    return make_pair(a.first.width(), a.first.height()) < make_pair(b.first.width(), b.first.height());
+                });
+                unique_ptr<Canvas> canvas;
+                for (auto& item : scenes) {
+                    const Scene& scene = item.first;
+                    Job& job = *item.second;
+                    try {
+                        if (canvas != nullptr && (canvas->width() != scene.width() || canvas->height() != scene.height())) {
+                            pool.release(move(canvas));
+                        }
+                        if (canvas == nullptr) {
+                            canvas = pool.acquire(scene);
+                        }
+                        pool.render(scene, *canvas);
+                        ostringstream out;
+                        canvas->draw(out, job.kind == protocol::Request::Render32 ? Bitmap::Type::bit32
+                                                                                  : Bitmap::Type::bit24);
+                        // The writer could not frame a larger answer and would drop the connection.
+                        if (static_cast<uint64_t>(out.tellp()) > protocol::maximumFrame) {
+                            counters.failed++;
+                            job.owner->complete(job, protocol::Response::Error, "bitmap larger than the frame limit");
+                            continue;
+                        }
+                        counters.completed++;
+                        job.owner->complete(job, protocol::Response::Bitmap, out.str());
+                    } catch (const exception& error) {
+                        // The canvas may be left with the scene's clips or half drawn.
+                        canvas.reset();
+                        counters.failed++;
+                        job.owner->complete(job, protocol::Response::Error, error.what());
+                    }
+                }
+                if (canvas != nullptr) {
+                    pool.release(move(canvas));
+                }
+            }
+        }
+    };
+
+    void usage() {
+        fprintf(stderr, "usage: sgrenderd [--socket PATH] [--workers N] [--queue N] [--batch N] [--pooled N]\n"
+                        "                [--pool-bytes BYTES] [--memory BYTES]\n"
+                        "  --socket   where to listen (default %s)\n"
+                        "  --workers  render threads, one per hardware thread by default\n"
+                        "  --queue    requests waiting for a worker before clients are held back (default 256)\n"
+                        "  --batch    requests a worker takes at once (default 8)\n"
+                        "  --pooled   idle canvases kept per scene size (default 4)\n"
+                        "  --pool-bytes  bytes of idle canvases kept in all; the sizes used least recently\n"
+                        "             go first (default 256 MiB)\n"
+                        "  --memory   most bytes of pixels in use at once; larger scenes fail (default no limit)\n",
+                protocol::defaultSocket);
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const string argument = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        const string value = argv[++i];
+        try {
+            if (argument == "--socket") {
+                options.socket = value;
+            } else if (argument == "--workers") {
+                options.workers = stoul(value);
+            } else if (argument == "--queue") {
+                options.queue = max<size_t>(1, stoul(value));
+            } else if (argument == "--batch") {
+                options.batch = max<size_t>(1, stoul(value));
+            } else if (argument == "--pooled") {
+                options.pooled = stoul(value);
+            } else if (argument == "--pool-bytes") {
+                options.poolBytes = stoull(value);
+            } else if (argument == "--memory") {
+                options.memory = stoull(value);
+            } else {
+                usage();
+                return 2;
+            }
+        } catch (const logic_error&) {
+            usage();
+            return 2;
+        }
+    }
+    MemoryBudget::process().setLimit(options.memory);
+    if (options.workers == 0) {
+        options.workers = max(1u, thread::hardware_concurrency());
+    }
+    // Requests already keep every core busy; see sgrender.
+    if (options.workers > 1) {
+        Executor::set(make_shared<ThreadPool>(1));
+    }
+
+    int listener = -1;
+    try {
+        const sockaddr_un address = protocol::address(options.socket);
+        // A socket file nobody answers on is left over from a daemon that did not exit cleanly.
+        try {
+            close(protocol::connect(options.socket));
+            fprintf(stderr, "sgrenderd: already listening on %s\n", options.socket.c_str());
+            return 1;
+        } catch (const runtime_error&) {
+            unlink(options.socket.c_str());
+        }
+        listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listener < 0 || bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(listener, 128) != 0) {
+            throw runtime_error("cannot listen on " + options.socket + ": " + strerror(errno));
+        }
+    } catch (const exception& error) {
+        fprintf(stderr, "sgrenderd: %s\n", error.what());
+        return 1;
+    }
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "sgrenderd: listening on %s with %zu workers\n", options.socket.c_str(), options.workers);
+
+    Server server(options);
+    server.serve(listener);
+    close(listener);
+    unlink(options.socket.c_str());
+    fprintf(stderr, "sgrenderd: %s\n", server.json().c_str());
+    return 0;
+}